@@ -3,22 +3,19 @@
 #define __ANIMATION_H__
 
 #include "SDL/include/SDL_rect.h"
+#include "SDL/include/SDL_render.h"
 #include "p2Defs.h"
 #include <vector>
 //#define MAX_FRAMES 25
 
+// Immutable clip data, shared by every instance that plays it
 class Animation
 {
 public:
 	bool loop = true;
 	float speed = 1.0f;
-	vector<SDL_Rect> frames;
-	SDL_RendererFlip flip;
-
-private:
-	float current_frame;
-	int last_frame = 0;
-	int loops = 0;
+	std::vector<SDL_Rect> frames;
+	SDL_RendererFlip flip = SDL_FLIP_NONE;
 
 public:
 
@@ -27,47 +24,54 @@ public:
 		frames.push_back(rect);
 	}
 
+	uint Count() const
+	{
+		return frames.size();
+	}
+};
+
+// Per-instance playback state of a shared Animation
+struct AnimationPlayhead
+{
+	uint clip = 0;
+	float current_frame = 0.0f;
+	int loops = 0;
+
+	// switches clip keeping the frame, so direction changes don't restart the cycle
+	void Play(uint new_clip)
+	{
+		clip = new_clip;
+	}
+
 	// return current_frame+speed frame Rect
-	SDL_Rect& GetCurrentFrame()
+	const SDL_Rect& GetCurrentFrame(const Animation& anim)
 	{
-		current_frame += speed;
-		if (current_frame >= frames.size())
+		current_frame += anim.speed;
+		if (current_frame >= anim.Count())
 		{
-			current_frame = (loop) ? 0.0f : frames.size() - 1;
+			current_frame = (anim.loop) ? 0.0f : anim.Count() - 1;
 			loops++;
 		}
 
-		return frames[(int)current_frame];
+		return anim.frames[(int)current_frame];
 	}
 
 	// return current_current frame Rect
-	SDL_Rect& GetActualFrame() {
-
-		return frames[(int)current_frame];
+	const SDL_Rect& GetActualFrame(const Animation& anim) const
+	{
+		return anim.frames[(int)current_frame];
 	}
 
-	float GetFrameIndex()const {
+	float GetFrameIndex() const
+	{
 		return current_frame;
 	}
 
-	void SetInitialFrame(uint frame) {
+	void SetInitialFrame(uint frame)
+	{
 		current_frame = (float)frame;
 	}
 
-	bool IsFrame(uint frame_index) {
-		return (current_frame == frame_index);
-	}
-
-	void AnimForward() {
-		current_frame += speed;
-		if (current_frame >= last_frame) current_frame = 0;
-	}
-
-	void AnimBack() {
-		current_frame -= speed;
-		if (current_frame < 0)current_frame = (float)last_frame - 1;
-	}
-
 	bool Finished() const
 	{
 		return loops > 0;
@@ -78,6 +82,6 @@ public:
 		current_frame = 0;
 		loops = 0;
 	}
-
 };
+
 #endif
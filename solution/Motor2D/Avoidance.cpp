@@ -0,0 +1,222 @@
+#include "Avoidance.h"
+
+#define AVOIDANCE_EPSILON simScalar(0.00001f)
+
+// Half plane of permitted velocities, the ones on the left of direction through point
+struct OrcaLine
+{
+	simPoint point;
+	simPoint direction;
+};
+
+static simScalar Dot(const simPoint& a, const simPoint& b)
+{
+	return a.x * b.x + a.y * b.y;
+}
+
+static simScalar Det(const simPoint& a, const simPoint& b)
+{
+	return a.x * b.y - a.y * b.x;
+}
+
+static simScalar LengthSq(const simPoint& a)
+{
+	return a.x * a.x + a.y * a.y;
+}
+
+// dividing each axis keeps fixed point precision, a reciprocal of a big length would lose it
+static simPoint Divide(const simPoint& a, simScalar d)
+{
+	return simPoint(a.x / d, a.y / d);
+}
+
+// Best velocity on line line_no that satisfies every previous line and the speed circle
+static bool SolveOnLine(const OrcaLine* lines, uint line_no, simScalar radius, const simPoint& optimal, bool direction_opt, simPoint& result)
+{
+	const OrcaLine& line = lines[line_no];
+	simScalar dot = Dot(line.point, line.direction);
+	simScalar discriminant = dot * dot + radius * radius - LengthSq(line.point);
+
+	// the speed circle doesn't reach this line
+	if (discriminant < 0)
+		return false;
+
+	simScalar sqrt_discriminant = Sqrt(discriminant);
+	simScalar t_left = -dot - sqrt_discriminant;
+	simScalar t_right = -dot + sqrt_discriminant;
+
+	for (uint i = 0; i < line_no; ++i) {
+		simScalar denominator = Det(line.direction, lines[i].direction);
+		simScalar numerator = Det(lines[i].direction, line.point - lines[i].point);
+
+		// parallel lines, either all of this one is allowed or none of it
+		if (Abs(denominator) <= AVOIDANCE_EPSILON) {
+			if (numerator < 0)
+				return false;
+			continue;
+		}
+
+		simScalar t = numerator / denominator;
+
+		if (denominator >= 0)
+			t_right = MIN(t_right, t);
+		else
+			t_left = MAX(t_left, t);
+
+		if (t_left > t_right)
+			return false;
+	}
+
+	if (direction_opt) {
+		result = line.point + line.direction * ((Dot(optimal, line.direction) > 0) ? t_right : t_left);
+	}
+	else {
+		simScalar t = Dot(line.direction, optimal - line.point);
+		result = line.point + line.direction * MAX(t_left, MIN(t, t_right));
+	}
+
+	return true;
+}
+
+// Incremental 2D linear program, returns the first line that couldn't be satisfied or count on success
+static uint Solve(const OrcaLine* lines, uint count, simScalar radius, const simPoint& optimal, bool direction_opt, simPoint& result)
+{
+	if (direction_opt)
+		result = optimal * radius;
+	else if (LengthSq(optimal) > radius * radius) {
+		result = optimal;
+		result.Normalize();
+		result = result * radius;
+	}
+	else
+		result = optimal;
+
+	for (uint i = 0; i < count; ++i) {
+		if (Det(lines[i].direction, lines[i].point - result) > 0) {
+			simPoint previous = result;
+			if (!SolveOnLine(lines, i, radius, optimal, direction_opt, result)) {
+				result = previous;
+				return i;
+			}
+		}
+	}
+
+	return count;
+}
+
+// Too crowded to satisfy every line, minimize the worst penetration from first_failed onwards
+static void SolveCrowded(const OrcaLine* lines, uint count, uint first_failed, simScalar radius, simPoint& result)
+{
+	OrcaLine projected[MAX_AVOIDANCE_NEIGHBOURS];
+	simScalar distance = 0;
+
+	for (uint i = first_failed; i < count; ++i) {
+		if (Det(lines[i].direction, lines[i].point - result) <= distance)
+			continue;
+
+		uint projected_count = 0;
+
+		for (uint j = 0; j < i; ++j) {
+			OrcaLine line;
+			simScalar determinant = Det(lines[i].direction, lines[j].direction);
+
+			if (Abs(determinant) <= AVOIDANCE_EPSILON) {
+				// same direction, line j is redundant
+				if (Dot(lines[i].direction, lines[j].direction) > 0)
+					continue;
+				line.point = (lines[i].point + lines[j].point) * simScalar(0.5f);
+			}
+			else
+				line.point = lines[i].point + lines[i].direction * (Det(lines[j].direction, lines[i].point - lines[j].point) / determinant);
+
+			line.direction = lines[j].direction - lines[i].direction;
+			line.direction.Normalize();
+			projected[projected_count++] = line;
+		}
+
+		simPoint previous = result;
+		if (Solve(projected, projected_count, radius, simPoint(-lines[i].direction.y, lines[i].direction.x), true, result) < projected_count)
+			result = previous;
+
+		distance = Det(lines[i].direction, lines[i].point - result);
+	}
+}
+
+simPoint ComputeAvoidanceVelocity(const AvoidanceAgent& agent, const simPoint& preferred, simScalar max_speed,
+	const AvoidanceAgent* neighbours, uint count, simScalar time_horizon, simScalar step)
+{
+	OrcaLine lines[MAX_AVOIDANCE_NEIGHBOURS];
+	simScalar inv_time_horizon = simScalar(1) / time_horizon;
+
+	count = MIN(count, MAX_AVOIDANCE_NEIGHBOURS);
+
+	for (uint i = 0; i < count; ++i) {
+		const AvoidanceAgent& other = neighbours[i];
+		simPoint relative_position = other.position - agent.position;
+		simPoint relative_velocity = agent.velocity - other.velocity;
+		simScalar dist_sq = LengthSq(relative_position);
+		simScalar combined_radius = agent.radius + other.radius;
+		simScalar combined_radius_sq = combined_radius * combined_radius;
+
+		OrcaLine& line = lines[i];
+		simPoint u;
+
+		if (dist_sq > combined_radius_sq) {
+			// vector from the cutoff center of the velocity obstacle to the relative velocity
+			simPoint w = relative_velocity - relative_position * inv_time_horizon;
+			simScalar w_length_sq = LengthSq(w);
+			simScalar dot = Dot(w, relative_position);
+
+			if (dot < 0 && dot * dot > combined_radius_sq * w_length_sq) {
+				// project on the cutoff circle
+				simScalar w_length = Sqrt(w_length_sq);
+				simPoint unit_w = Divide(w, w_length);
+
+				line.direction = simPoint(unit_w.y, -unit_w.x);
+				u = unit_w * (combined_radius * inv_time_horizon - w_length);
+			}
+			else {
+				// project on the closest leg of the cone
+				simScalar leg = Sqrt(dist_sq - combined_radius_sq);
+
+				if (Det(relative_position, w) > 0)
+					line.direction = Divide(simPoint(relative_position.x * leg - relative_position.y * combined_radius, relative_position.x * combined_radius + relative_position.y * leg), dist_sq);
+				else
+					line.direction = Divide(simPoint(relative_position.x * leg + relative_position.y * combined_radius, -relative_position.x * combined_radius + relative_position.y * leg), -dist_sq);
+
+				u = line.direction * Dot(relative_velocity, line.direction) - relative_velocity;
+			}
+		}
+		else {
+			// already overlapping, get out within this step
+			simScalar inv_step = simScalar(1) / step;
+			simPoint w = relative_velocity - relative_position * inv_step;
+			simScalar w_length = Sqrt(LengthSq(w));
+
+			if (w_length <= AVOIDANCE_EPSILON) {
+				// same spot and speed, any direction will do as long as both don't pick the same
+				w = simPoint(relative_position.y, -relative_position.x);
+				w_length = simScalar(1);
+				if (LengthSq(w) <= AVOIDANCE_EPSILON)
+					w = simPoint(1, 0);
+				else
+					w.Normalize();
+			}
+
+			simPoint unit_w = Divide(w, w_length);
+
+			line.direction = simPoint(unit_w.y, -unit_w.x);
+			u = unit_w * (combined_radius * inv_step - w_length);
+		}
+
+		line.point = agent.velocity + u * other.responsibility;
+	}
+
+	simPoint result;
+	uint failed = Solve(lines, count, max_speed, preferred, false, result);
+
+	if (failed < count)
+		SolveCrowded(lines, count, failed, max_speed, result);
+
+	return result;
+}
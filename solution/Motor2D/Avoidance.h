@@ -0,0 +1,26 @@
+#ifndef __AVOIDANCE_H__
+#define __AVOIDANCE_H__
+
+#include "p2Fixed.h"
+#include "p2Defs.h"
+
+// Neighbours taken into account per unit, the closest ones are kept
+#define MAX_AVOIDANCE_NEIGHBOURS 10
+
+// A unit as seen by the avoidance solver, velocities in pixels per second
+struct AvoidanceAgent
+{
+	simPoint position;
+	simPoint velocity;
+	simScalar radius = simScalar(0);
+	// share of the avoidance this unit takes against the agent: half when both move, all of it against idle ones
+	simScalar responsibility = simScalar(0.5f);
+};
+
+// Optimal reciprocal collision avoidance: returns the velocity closest to preferred, no faster than
+// max_speed, that keeps agent clear of every neighbour for time_horizon seconds.
+// Neighbours already overlapping are pushed apart within one step.
+simPoint ComputeAvoidanceVelocity(const AvoidanceAgent& agent, const simPoint& preferred, simScalar max_speed,
+	const AvoidanceAgent* neighbours, uint count, simScalar time_horizon, simScalar step);
+
+#endif // __AVOIDANCE_H__
@@ -0,0 +1,134 @@
+#include "CommandLog.h"
+#include "p2Log.h"
+#include "j1App.h"
+#include "j1FileSystem.h"
+#include <sstream>
+#include <string.h>
+
+static const char* commandNames[] = { "select", "move", "camera" };
+
+void CommandLog::Clear()
+{
+	commands.clear();
+	next = 0;
+	ticks = 0;
+}
+
+void CommandLog::Record(const Command& command)
+{
+	commands.push_back(command);
+}
+
+const Command* CommandLog::Next(uint tick)
+{
+	if (next == commands.size() || commands[next].tick > tick)
+		return nullptr;
+
+	return &commands[next++];
+}
+
+bool CommandLog::Finished(uint tick) const
+{
+	return next == commands.size() && tick >= ticks;
+}
+
+bool CommandLog::Save(const char* file) const
+{
+	pugi::xml_document data;
+	pugi::xml_node root = data.append_child("replay");
+
+	root.append_attribute("version") = COMMAND_LOG_VERSION;
+	root.append_attribute("seed") = seed;
+	root.append_attribute("ticks") = ticks;
+
+	for (uint i = 0; i < commands.size(); i++) {
+		const Command& command = commands[i];
+		pugi::xml_node node = root.append_child("command");
+
+		node.append_attribute("type") = commandNames[command.type];
+		node.append_attribute("tick") = command.tick;
+
+		if (command.type != COMMAND_SELECT) {
+			node.append_attribute("x") = command.destination.x;
+			node.append_attribute("y") = command.destination.y;
+		}
+
+		for (uint j = 0; j < command.units.size(); j++) {
+			pugi::xml_node unit = node.append_child("unit");
+			unit.append_attribute("index") = command.units[j].index;
+			unit.append_attribute("generation") = command.units[j].generation;
+		}
+	}
+
+	std::stringstream stream;
+	data.save(stream);
+
+	const std::string& text = stream.str();
+	if (App->fs->Save(file, text.c_str(), text.length()) == 0) {
+		LOG("Could not save the command log to %s", file);
+		return false;
+	}
+
+	LOG("Saved %u commands over %u ticks to %s", (uint)commands.size(), ticks, file);
+	return true;
+}
+
+bool CommandLog::Load(const char* file)
+{
+	Clear();
+
+	char* buffer = NULL;
+	uint size = App->fs->Load(file, &buffer);
+
+	if (size == 0) {
+		LOG("Could not load command log %s", file);
+		return false;
+	}
+
+	pugi::xml_document data;
+	pugi::xml_parse_result result = data.load_buffer(buffer, size);
+	RELEASE_ARRAY(buffer);
+
+	if (result == NULL) {
+		LOG("Could not parse command log %s. pugi error: %s", file, result.description());
+		return false;
+	}
+
+	pugi::xml_node root = data.child("replay");
+
+	if (root.attribute("version").as_uint() != COMMAND_LOG_VERSION) {
+		LOG("Command log %s has version %d, expected %d", file, root.attribute("version").as_uint(), COMMAND_LOG_VERSION);
+		return false;
+	}
+
+	seed = root.attribute("seed").as_uint();
+	ticks = root.attribute("ticks").as_uint();
+
+	for (pugi::xml_node node = root.child("command"); node; node = node.next_sibling("command")) {
+		Command command;
+		const char* type = node.attribute("type").as_string();
+
+		if (strcmp(type, commandNames[COMMAND_MOVE]) == 0)
+			command.type = COMMAND_MOVE;
+		else if (strcmp(type, commandNames[COMMAND_CAMERA]) == 0)
+			command.type = COMMAND_CAMERA;
+		else
+			command.type = COMMAND_SELECT;
+
+		command.tick = node.attribute("tick").as_uint();
+		command.destination.x = node.attribute("x").as_int();
+		command.destination.y = node.attribute("y").as_int();
+
+		for (pugi::xml_node unit = node.child("unit"); unit; unit = unit.next_sibling("unit")) {
+			EntityHandle handle;
+			handle.index = unit.attribute("index").as_uint();
+			handle.generation = unit.attribute("generation").as_uint();
+			command.units.push_back(handle);
+		}
+
+		commands.push_back(command);
+	}
+
+	LOG("Loaded %u commands over %u ticks from %s", (uint)commands.size(), ticks, file);
+	return true;
+}
@@ -0,0 +1,54 @@
+#ifndef __COMMANDLOG_H__
+#define __COMMANDLOG_H__
+
+#include "p2Point.h"
+#include "p2Defs.h"
+#include "Entity.h"
+#include <vector>
+
+#define COMMAND_LOG_VERSION 1
+
+enum commandType {
+	COMMAND_SELECT, COMMAND_MOVE, COMMAND_CAMERA
+};
+
+// An order as the simulation sees it, it runs at the start of tick.
+// Select replaces the selection with units, move sends units to the destination tile,
+// camera moves the view to destination, which decides what runs at reduced rate.
+struct Command
+{
+	commandType type = COMMAND_SELECT;
+	uint tick = 0;
+	iPoint destination = { 0, 0 };
+	std::vector<EntityHandle> units;
+};
+
+// Every command of a match in the order it ran, plus what the match needs besides input
+// to play out the same: the random seed and how many ticks it lasted.
+class CommandLog
+{
+public:
+
+	void Clear();
+	void Record(const Command& command);
+
+	// the command due at tick, nullptr when the next one is for a later tick
+	const Command* Next(uint tick);
+	bool Finished(uint tick) const;
+
+	bool Save(const char* file) const;
+	bool Load(const char* file);
+
+public:
+
+	uint seed = 0;
+	uint ticks = 0;
+
+private:
+
+	std::vector<Command> commands;
+	// replay position
+	uint next = 0;
+};
+
+#endif // __COMMANDLOG_H__
@@ -1,4 +1,5 @@
 #include "Entity.h"
+#include "p2Snapshot.h"
 
 Entity::Entity()
 {
@@ -49,3 +50,23 @@ bool Entity::Save(pugi::xml_node &) const
 	return true;
 }
 
+bool Entity::LoadSnapshot(SnapshotReader& data)
+{
+	data.Read(entityID);
+	data.Read(isActive);
+	data.Read(entityPosition);
+	data.Read(handle);
+	data.Read(soft_collider);
+	return data.Read(hard_collider);
+}
+
+bool Entity::SaveSnapshot(SnapshotWriter& data) const
+{
+	data.Write(entityID);
+	data.Write(isActive);
+	data.Write(entityPosition);
+	data.Write(handle);
+	data.Write(soft_collider);
+	data.Write(hard_collider);
+	return true;
+}
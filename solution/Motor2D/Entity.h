@@ -2,18 +2,24 @@
 #define __ENTITY_H__
 
 #include "p2Point.h"
+#include "p2Handle.h"
 #include "SDL\include\SDL.h"
 #include "PugiXml\src\pugixml.hpp"
 
 using namespace std;
 
 struct Collider;
+class SnapshotReader;
+class SnapshotWriter;
+
+// Stays valid after the entity is gone, EntityManager::GetUnit returns nullptr for it then
+typedef p2Handle EntityHandle;
 
 class Entity
 {
 public:
 	Entity();
-	~Entity();
+	virtual ~Entity();
 	iPoint GetPosition() const;
 	int GetEntityID() const;
 	void SetActive(bool active);
@@ -24,6 +30,8 @@ public:
 
 	virtual bool Load(pugi::xml_node&);
 	virtual bool Save(pugi::xml_node&) const;
+	virtual bool LoadSnapshot(SnapshotReader&);
+	virtual bool SaveSnapshot(SnapshotWriter&) const;
 
 
 public:
@@ -31,8 +39,9 @@ public:
 	bool isActive = false;
 	SDL_Texture* entityTexture;
 	iPoint entityPosition;
-	Collider* soft_collider;
-	Collider* hard_collider;
+	EntityHandle handle;
+	p2Handle soft_collider;
+	p2Handle hard_collider;
 };
 
 #endif // !__ENTITY_H__
\ No newline at end of file
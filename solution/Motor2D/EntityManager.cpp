@@ -6,6 +6,12 @@
 #include "Unit.h"
 #include "j1Render.h"
 #include "j1Pathfinding.h"
+#include "j1FogOfWar.h"
+#include "j1Textures.h"
+#include "p2Snapshot.h"
+#include <algorithm>
+#include <stdlib.h>
+#include <time.h>
 
 EntityManager::EntityManager() : j1Module()
 {
@@ -19,15 +25,121 @@ EntityManager::~EntityManager()
 
 bool EntityManager::Awake(pugi::xml_node & config)
 {
+	recordFile.create("%s", config.attribute("record").as_string(""));
+
+	return LoadArchetypes();
+}
+
+// Cuts a sprite sheet in one clip per row, the rows between the first and the last
+// are reused flipped for the directions on the other side
+static void BuildClips(const AnimationLayout& layout, vector<Animation>& clips)
+{
+	for (int i = 0; i < layout.rows; i++) {
+		Animation clip;
+		for (int j = 0; j < layout.columns; j++) {
+			clip.PushBack({ layout.width*j,layout.height*i,layout.width,layout.height });
+		}
+		clip.speed = layout.speed;
+		clips.push_back(clip);
+		if (i != 0 && i != layout.rows - 1) {
+			clip.flip = SDL_FLIP_HORIZONTAL;
+			clips.push_back(clip);
+		}
+	}
+}
+
+// Parses GameData.xml once, units are created from these afterwards
+bool EntityManager::LoadArchetypes()
+{
+	static const char* animationNames[MAX_UNIT_ANIMATIONS] = { "Idle", "Move", "Attack", "Die" };
+
+	pugi::xml_document gameDataFile;
+	pugi::xml_node gameData = App->LoadGameData(gameDataFile);
+
+	if (gameData.empty() == true)
+		return false;
+
+	for (pugi::xml_node unit = gameData.child("Units").child("Unit"); unit; unit = unit.next_sibling("Unit")) {
+
+		int id = unit.child("Info").child("ID").attribute("value").as_int(-1);
+		if (id < 0)
+			continue;
+
+		if (id >= (int)archetypes.size())
+			archetypes.resize(id + 1);
+
+		UnitArchetype& archetype = archetypes[id];
+		pugi::xml_node stats = unit.child("Stats");
+
+		archetype.type = (unitType)id;
+		archetype.faction = (unitFaction)stats.child("Faction").attribute("value").as_int();
+		archetype.life = stats.child("Life").attribute("value").as_int();
+		archetype.attack = stats.child("Attack").attribute("value").as_int();
+		archetype.attackSpeed = stats.child("AttackSpeed").attribute("value").as_float();
+		archetype.defense = stats.child("Defense").attribute("value").as_int();
+		archetype.piercingDamage = stats.child("PiercingDamage").attribute("value").as_int();
+		archetype.movementSpeed = stats.child("MovementSpeed").attribute("value").as_float();
+		archetype.lineOfSight = stats.child("LineOfSight").attribute("value").as_int();
+
+		for (int i = 0; i < MAX_UNIT_ANIMATIONS; i++) {
+			pugi::xml_node animationNode = unit.child("Animations").child(animationNames[i]);
+			AnimationLayout& layout = archetype.animations[i];
+
+			layout.width = animationNode.child("Width").attribute("value").as_int();
+			layout.height = animationNode.child("Height").attribute("value").as_int();
+			layout.rows = animationNode.child("Rows").attribute("value").as_int();
+			layout.columns = animationNode.child("Columns").attribute("value").as_int();
+			layout.speed = animationNode.child("Speed").attribute("value").as_float();
+
+			archetype.texturePaths[i] = unit.child("Textures").child(animationNames[i]).attribute("value").as_string();
+
+			archetype.firstClip[i] = archetype.clips.size();
+			BuildClips(layout, archetype.clips);
+		}
+
+		archetype.loaded = true;
+	}
+
+	LOG("Loaded %d unit archetypes", archetypes.size());
 
 	return true;
 }
 
+// Textures are only loaded the first time a type is needed
+const UnitArchetype* EntityManager::GetArchetype(unitType type)
+{
+	if (type < 0 || type >= (int)archetypes.size() || archetypes[type].loaded == false) {
+		LOG("Unknown unit type %d", type);
+		return nullptr;
+	}
+
+	UnitArchetype& archetype = archetypes[type];
+
+	for (int i = 0; i < MAX_UNIT_ANIMATIONS; i++) {
+		if (archetype.textures[i] == nullptr)
+			archetype.textures[i] = App->tex->Load(archetype.texturePaths[i].c_str());
+	}
+
+	return &archetype;
+}
+
 bool EntityManager::Start()
 {
 	LOG("Starting EntityManager");
 	bool ret = true;
 	drawMultiSelectionRect = false;
+	workerArrivals.resize(App->workers.GetWorkerCount());
+	workerNeighbours.resize(App->workers.GetWorkerCount(), vector<Collider*>(AVOIDANCE_QUERY_RESULTS));
+	loggedCamera.create(App->render->camera.x, App->render->camera.y);
+
+	// a replay brings its own seed, so anything random plays out the same
+	if (App->IsReplaying())
+		ret = commandLog.Load(App->GetReplayFile());
+	else
+		commandLog.seed = (uint)time(NULL);
+
+	srand(commandLog.seed);
+
 	return ret;
 }
 
@@ -36,11 +148,45 @@ bool EntityManager::PreUpdate()
 	return true;
 }
 
+bool EntityManager::FixedUpdate(float step)
+{
+	simScalar sim_step(step);
+
+	RunCommands();
+#ifndef DETERMINISTIC_SIMULATION
+	// every machine has its own camera, so deterministic builds run everything at full rate
+	LODPass();
+#endif
+	MovementPass(sim_step);
+	CombatPass(sim_step);
+	DirectionPass();
+
+#ifdef DETERMINISTIC_SIMULATION
+	// nothing that feeds back into the simulation may depend on the frame rate
+	CorpsePass(sim_step);
+	SnapPass();
+
+	for (uint i = 0; i < units.Count(); i++)
+		units.unit[i]->UpdateColliders();
+#endif
+
+	tick++;
+
+	return true;
+}
+
 bool EntityManager::IsOccupied(iPoint tile, Unit* ignore_unit) {
 
-	for (list<Unit*>::iterator it = friendlyUnitList.begin(); it != friendlyUnitList.end(); it++) {
-		if ((*it) != ignore_unit) {
-			if (tile == App->map->WorldToMap((*it)->entityPosition.x, (*it)->entityPosition.y) && (*it)->state == UNIT_IDLE)
+	// colliders sit at the unit's feet, so look a bit below the tile as well
+	iPoint world = App->map->MapToWorld(tile.x, tile.y);
+	SDL_Rect area = { world.x - App->map->data.tile_width / 2, world.y, App->map->data.tile_width, App->map->data.tile_height + COLLISION_CELL_SIZE };
+
+	uint found = App->collision->QueryRect(area, queryResults, MAX_QUERY_RESULTS, LAYER_HARD_UNITS);
+
+	for (uint i = 0; i < found; i++) {
+		Unit* unit = queryResults[i]->GetUnit();
+		if (unit != nullptr && unit != ignore_unit) {
+			if (tile == App->map->WorldToMap(unit->entityPosition.x, unit->entityPosition.y) && unit->GetState() == UNIT_IDLE)
 				return true;
 		}
 	}
@@ -49,76 +195,740 @@ bool EntityManager::IsOccupied(iPoint tile, Unit* ignore_unit) {
 
 }
 
-bool EntityManager::Update(float dt)
+// Closest walkable and free tile around tile that isn't taken yet, rings grow outwards
+static iPoint FindFreeSlot(const iPoint& tile, const vector<iPoint>& taken)
 {
-	int mouseX;
-	int mouseY;
-	App->input->GetMousePosition(mouseX, mouseY);
-	mouseX -= App->render->camera.x;
-	mouseY -= App->render->camera.y;
+	for (int dist = 0; dist <= FORMATION_SEARCH_RADIUS; dist++) {
+		for (int i = -dist; i <= dist; i++) {
+			for (int j = -dist; j <= dist; j++) {
+
+				// only the ring at dist, the inside was checked already
+				if (abs(i) != dist && abs(j) != dist)
+					continue;
+
+				iPoint candidate(tile.x + i, tile.y + j);
+
+				if (!App->pathfinding->IsWalkable(candidate) || App->entityManager->IsOccupied(candidate))
+					continue;
+
+				if (std::find(taken.begin(), taken.end(), candidate) == taken.end())
+					return candidate;
+			}
+		}
+	}
+
+	return tile;
+}
+
+void EntityManager::MoveGroup(const vector<Unit*>& group, const iPoint& target)
+{
+	if (group.empty() || !App->pathfinding->IsWalkable(target))
+		return;
+
+	// formation slots are shared by the whole group and face the way it travels
+	simPoint center(0, 0);
+	for (uint i = 0; i < group.size(); i++)
+		center += units.position[group[i]->simIndex];
+	center = simPoint(center.x / (int)group.size(), center.y / (int)group.size());
+
+	iPoint center_tile = App->map->WorldToMap(RoundToInt(center.x), RoundToInt(center.y));
+	iPoint dir = FormationDirection(simPoint(target.x - center_tile.x, target.y - center_tile.y));
+	GenerateFormationSlots(formation, group.size(), dir, formationSlots);
+
+	slotTiles.clear();
+	slotPositions.clear();
+	groupPositions.clear();
+	for (uint i = 0; i < formationSlots.size(); i++) {
+		iPoint slot(target.x + formationSlots[i].x, target.y + formationSlots[i].y);
+		slotTiles.push_back(FindFreeSlot(slot, slotTiles));
 
+		iPoint world = App->map->MapToWorld(slotTiles[i].x + 1, slotTiles[i].y);
+		slotPositions.push_back(simPoint(world.x, world.y));
+		groupPositions.push_back(units.position[group[i]->simIndex]);
+	}
+
+	AssignFormationSlots(groupPositions, slotPositions, slotAssignment);
+
+	// units starting in the same region share one path search
+	orderEntries.clear();
+	for (uint i = 0; i < group.size(); i++) {
+		iPoint tile = App->map->WorldToMap(group[i]->entityPosition.x, group[i]->entityPosition.y);
+		int rx = (int)floorf(tile.x / (float)ORDER_REGION_SIZE);
+		int ry = (int)floorf(tile.y / (float)ORDER_REGION_SIZE);
 
-	for (list<Unit*>::iterator it = friendlyUnitList.begin(); it != friendlyUnitList.end(); it++) {
-		(*it)->Update(dt);
-		(*it)->Draw();
+		OrderEntry entry = { ((uint64)(uint32)ry << 32) | (uint32)rx, i };
+		orderEntries.push_back(entry);
 	}
+	std::sort(orderEntries.begin(), orderEntries.end());
+
+	uint searches = 0;
+	for (uint begin = 0, end = 0; begin < orderEntries.size(); begin = end) {
+
+		simPoint region_center(0, 0);
+		for (end = begin; end < orderEntries.size() && orderEntries[end].region == orderEntries[begin].region; end++)
+			region_center += groupPositions[orderEntries[end].unit];
+		region_center = simPoint(region_center.x / int(end - begin), region_center.y / int(end - begin));
+
+		// the unit closest to the region's center leads
+		uint leader = orderEntries[begin].unit;
+		for (uint i = begin + 1; i < end; i++) {
+			if (groupPositions[orderEntries[i].unit].DistanceNoSqrt(region_center) < groupPositions[leader].DistanceNoSqrt(region_center))
+				leader = orderEntries[i].unit;
+		}
+
+		iPoint origin = App->map->WorldToMap(group[leader]->entityPosition.x, group[leader]->entityPosition.y);
+		searches++;
+
+		if (App->pathfinding->CreatePath(origin, target) < 0) {
+			LOG("No path for %d units from %d,%d to %d,%d", end - begin, origin.x, origin.y, target.x, target.y);
+			continue;
+		}
+
+		const p2DynArray<iPoint>* last_path = App->pathfinding->GetLastPath();
+		leaderPath.clear();
+		for (uint i = 0; i < last_path->Count(); i++)
+			leaderPath.push_back(*last_path->At(i));
+
+		for (uint i = begin; i < end; i++) {
+			uint unit = orderEntries[i].unit;
+			const iPoint& slot = slotTiles[slotAssignment[unit]];
+			iPoint offset(slot.x - target.x, slot.y - target.y);
 
-	if (App->input->GetMouseButtonDown(SDL_BUTTON_RIGHT) == KEY_DOWN) {		
-		for (list<Unit*>::iterator it = friendlyUnitList.begin(); it != friendlyUnitList.end(); it++) {
+			// leader's waypoints shifted by the slot, the origin is skipped as we are already around it
+			unitPath.clear();
+			for (uint j = 1; j + 1 < leaderPath.size(); j++) {
+				iPoint waypoint(leaderPath[j].x + offset.x, leaderPath[j].y + offset.y);
+				unitPath.push_back(App->pathfinding->IsWalkable(waypoint) ? waypoint : leaderPath[j]);
+			}
+			unitPath.push_back(slot);
 
-			if ((*it)->isSelected) 
-				(*it)->SetDestination();
+			group[unit]->FollowPath(unitPath);
 		}
 	}
 
-	if (App->input->GetMouseButtonDown(SDL_BUTTON_LEFT) == KEY_DOWN) {
-		multiSelectionRect.x = mouseX;
-		multiSelectionRect.y = mouseY;
+	LOG("Move order for %u units took %u path searches", (uint)group.size(), searches);
+}
+
+bool EntityManager::Update(float dt)
+{
+#ifndef DETERMINISTIC_SIMULATION
+	InterpolationPass(App->GetInterpolationAlpha());
+#endif
+	VisibilityPass();
+	AnimationPass();
+
+	for (uint i = 0; i < units.Count(); i++) {
+#ifndef DETERMINISTIC_SIMULATION
+		units.unit[i]->UpdateColliders();
+#endif
+
+		if (units.lod[i] == LOD_FULL && units.unit[i]->isVisible)
+			units.unit[i]->Draw();
+	}
+
+	HandleSelection();
+
+	if (drawMultiSelectionRect) {
+		App->render->DrawQuad(multiSelectionRect, 255, 255, 255, 255, false);
 	}
 
-	if (App->input->GetMouseButtonDown(SDL_BUTTON_LEFT) == KEY_REPEAT) {
+	return true;
+}
+
+// Mouse picking and orders, nothing is done unless a button changed or is being dragged
+void EntityManager::HandleSelection()
+{
+	j1KeyState left = App->input->GetMouseButtonDown(SDL_BUTTON_LEFT);
+	j1KeyState right = App->input->GetMouseButtonDown(SDL_BUTTON_RIGHT);
+
+	if (left == KEY_IDLE && right != KEY_DOWN)
+		return;
+
+	int mouseX;
+	int mouseY;
+	App->input->GetMousePosition(mouseX, mouseY);
+	mouseX -= App->render->camera.x;
+	mouseY -= App->render->camera.y;
+
+	if (right == KEY_DOWN)
+		IssueCommand(COMMAND_MOVE, selectedUnitList, App->map->WorldToMap(mouseX, mouseY));
+
+	switch (left) {
+	case KEY_DOWN:
+		multiSelectionRect = { mouseX, mouseY, 0, 0 };
+		break;
+
+	case KEY_REPEAT:
 		multiSelectionRect.w = mouseX - multiSelectionRect.x;
 		multiSelectionRect.h = mouseY - multiSelectionRect.y;
 		if (drawMultiSelectionRect == false) {
 			drawMultiSelectionRect = true;
 		}
-	}
+		break;
+
+	case KEY_UP:
+		pickedUnits.clear();
 
-	if (App->input->GetMouseButtonDown(SDL_BUTTON_LEFT) == KEY_UP) {
 		if (drawMultiSelectionRect == true) {
 			drawMultiSelectionRect = false;
 
-			for (list<Unit*>::iterator it = friendlyUnitList.begin(); it != friendlyUnitList.end(); it++) {
-				if ((*it)->entityPosition.x > multiSelectionRect.x && (*it)->entityPosition.x < multiSelectionRect.x + multiSelectionRect.w &&
-					(*it)->entityPosition.y > multiSelectionRect.y && (*it)->entityPosition.y <  multiSelectionRect.y + multiSelectionRect.h) {
-					(*it)->isSelected = true;
-				}
+			if (selectionResults.empty())
+				selectionResults.resize(MAX_QUERY_RESULTS);
+
+			// a full buffer may have left units out, ask again with room for twice as many
+			uint found;
+			while ((found = App->collision->QueryRect(multiSelectionRect, selectionResults.data(), selectionResults.size(), LAYER_HARD_UNITS)) == selectionResults.size())
+				selectionResults.resize(selectionResults.size() * 2);
+
+			for (uint i = 0; i < found; i++) {
+				Unit* unit = selectionResults[i]->GetUnit();
+				if (unit != nullptr && unit->isVisible)
+					pickedUnits.push_back(unit);
 			}
+
 			multiSelectionRect = { 0,0,0,0 };
 		}
+		else {
+			// a click picks the unit whose sprite is under the cursor, the closest one if several are
+			iPoint mouse(mouseX, mouseY);
+			uint found = App->collision->QueryCircle(mouse, SELECTION_PICK_RANGE, queryResults, MAX_QUERY_RESULTS, LAYER_HARD_UNITS);
+			Unit* picked = nullptr;
+
+			for (uint i = 0; i < found; i++) {
+				Unit* unit = queryResults[i]->GetUnit();
+				if (unit == nullptr || !unit->isVisible)
+					continue;
+
+				const SDL_Rect& frame = unit->GetAnim().GetActualFrame(unit->GetCurrentClip());
+				if (abs(mouse.x - unit->entityPosition.x) > frame.w / 2 || abs(mouse.y - unit->entityPosition.y) > frame.h / 2)
+					continue;
+
+				if (picked == nullptr || unit->entityPosition.DistanceNoSqrt(mouse) < picked->entityPosition.DistanceNoSqrt(mouse))
+					picked = unit;
+			}
+
+			if (picked != nullptr)
+				pickedUnits.push_back(picked);
+		}
+
+		IssueCommand(COMMAND_SELECT, pickedUnits, iPoint(0, 0));
+		break;
 	}
+}
 
-	if (drawMultiSelectionRect) {
-		App->render->DrawQuad(multiSelectionRect, 255, 255, 255, 255, false);
+void EntityManager::IssueCommand(commandType type, const vector<Unit*>& group, const iPoint& destination)
+{
+	Command command;
+	command.type = type;
+	command.destination = destination;
+
+	for (uint i = 0; i < group.size(); i++)
+		command.units.push_back(group[i]->handle);
+
+	pendingCommands.push_back(command);
+}
+
+// Orders only change the simulation here, between two ticks, so a replay of the log
+// runs each of them on the same tick it ran the first time
+void EntityManager::RunCommands()
+{
+	if (App->IsReplaying()) {
+		for (const Command* command = commandLog.Next(tick); command != nullptr; command = commandLog.Next(tick))
+			ExecuteCommand(*command);
+		return;
 	}
 
-	return true;
+	const SDL_Rect& camera = App->render->camera;
+	if (camera.x != loggedCamera.x || camera.y != loggedCamera.y) {
+		loggedCamera.create(camera.x, camera.y);
+		IssueCommand(COMMAND_CAMERA, vector<Unit*>(), loggedCamera);
+	}
+
+	for (uint i = 0; i < pendingCommands.size(); i++) {
+		pendingCommands[i].tick = tick;
+		commandLog.Record(pendingCommands[i]);
+		ExecuteCommand(pendingCommands[i]);
+	}
+
+	pendingCommands.clear();
 }
 
-bool EntityManager::PostUpdate()
+void EntityManager::ExecuteCommand(const Command& command)
+{
+	// units may have died since the order was given
+	commandUnits.clear();
+	for (uint i = 0; i < command.units.size(); i++) {
+		Unit* unit = GetUnit(command.units[i]);
+		if (unit != nullptr)
+			commandUnits.push_back(unit);
+	}
+
+	switch (command.type) {
+	case COMMAND_SELECT:
+		ClearSelection();
+		for (uint i = 0; i < commandUnits.size(); i++)
+			Select(commandUnits[i]);
+		break;
+
+	case COMMAND_MOVE:
+		MoveGroup(commandUnits, command.destination);
+		break;
+
+	case COMMAND_CAMERA:
+		App->render->camera.x = command.destination.x;
+		App->render->camera.y = command.destination.y;
+		break;
+	}
+}
+
+bool EntityManager::ReplayFinished() const
+{
+	return commandLog.Finished(tick);
+}
+
+void EntityManager::Select(Unit* unit)
+{
+	if (unit == nullptr || unit->isSelected)
+		return;
+
+	unit->isSelected = true;
+	selectedUnitList.push_back(unit);
+}
+
+void EntityManager::ClearSelection()
+{
+	for (uint i = 0; i < selectedUnitList.size(); i++)
+		selectedUnitList[i]->isSelected = false;
+
+	selectedUnitList.clear();
+}
+
+const vector<Unit*>& EntityManager::GetSelectedUnits() const
+{
+	return selectedUnitList;
+}
+
+// Advances every moving unit one prediction step across the worker threads. Each unit
+// only reads its own previous state and writes its own next state, so jobs need no locks.
+// Arrivals touch the unit's path and are resolved serially once every job is done.
+void EntityManager::MovementPass(simScalar step)
+{
+	for (uint i = 0; i < workerArrivals.size(); i++)
+		workerArrivals[i].clear();
+
+	App->workers.ParallelFor(units.Count(), UNITS_PER_MOVEMENT_JOB, [this, step](uint begin, uint end, uint worker) {
+		MoveUnits(begin, end, step, workerArrivals[worker], workerNeighbours[worker]);
+	});
+
+	units.SwapBuffers();
+
+	// chunks are handed out dynamically, sort so events always fire in the same order
+	arrivals.clear();
+	for (uint i = 0; i < workerArrivals.size(); i++) {
+		for (uint j = 0; j < workerArrivals[i].size(); j++)
+			arrivals.push_back(units.unit[workerArrivals[i][j]]);
+	}
+	std::sort(arrivals.begin(), arrivals.end(), [](const Unit* a, const Unit* b) { return a->simIndex < b->simIndex; });
+
+	for (uint i = 0; i < arrivals.size(); i++)
+		arrivals[i]->OnWaypointReached();
+}
+
+// Steps along the straight line to target, one prediction per tick
+static void FillPredictions(PredictionQueue& predictions, Pred_Pos from, const simPoint& target, simScalar speed, simScalar step)
 {
-	if (removeUnitList.size() > 0) {
-		list<Unit*>::iterator i = removeUnitList.begin();
+	while (predictions.count < MAX_PRED_POS) {
+		from = Unit::PredictStep(from, target, speed, step);
+		predictions.PushBack(from);
+	}
+}
+
+void EntityManager::MoveUnits(uint begin, uint end, simScalar step, vector<uint>& arrived, vector<Collider*>& found)
+{
+	AvoidanceAgent neighbours[MAX_AVOIDANCE_NEIGHBOURS];
+
+	simScalar full_step = step;
+
+	for (uint i = begin; i < end; i++) {
 
-		while (i != removeUnitList.end())
-		{
-			list<Unit*>::iterator unitToDestroy = i;
-			++i;
-			DestroyEntity((*unitToDestroy));
+		if (units.state[i] != UNIT_MOVING) {
+			units.nextPosition[i] = units.position[i];
+			units.nextVelocity[i] = simPoint(0, 0);
+			continue;
 		}
 
-		removeUnitList.clear();
+		// reduced units take turns so they don't all land on the same tick
+		step = full_step;
+		if (units.lod[i] == LOD_REDUCED) {
+			if ((tick + i) % LOD_REDUCED_INTERVAL != 0) {
+				units.nextPosition[i] = units.position[i];
+				units.nextVelocity[i] = units.velocity[i];
+				continue;
+			}
+			step = full_step * LOD_REDUCED_INTERVAL;
+		}
+
+		PredictionQueue& predictions = units.predictions[i];
+		const simPoint& target = units.waypoint[i];
+
+		if (predictions.Empty()) {
+			simPoint vel(target.x - units.position[i].x, target.y - units.position[i].y);
+			if (vel.x != 0 || vel.y != 0)
+				vel.Normalize();
+
+			FillPredictions(predictions, Pred_Pos(units.position[i], Unit::GetDirection(vel), vel), target, units.speed[i], step);
+		}
+
+		// the oldest prediction is where we would like to be after this tick
+		Pred_Pos next = predictions.PopFront();
+		simPoint preferred((next.pos.x - units.position[i].x) / step, (next.pos.y - units.position[i].y) / step);
+		simPoint velocity = preferred;
+
+		uint count = GatherNeighbours(i, found, neighbours);
+		if (count > 0) {
+			AvoidanceAgent agent;
+			agent.position = units.position[i];
+			agent.velocity = units.velocity[i];
+			agent.radius = units.radius[i];
+
+			velocity = ComputeAvoidanceVelocity(agent, preferred, units.speed[i] * simScalar(UNIT_SPEED_SCALE), neighbours, count, simScalar(AVOIDANCE_TIME_HORIZON), step);
+		}
+
+		if (velocity.DistanceNoSqrt(preferred) > simScalar(0.01f)) {
+			// steering away from the straight line, predictions restart from where we end up
+			next.pos = units.position[i] + velocity * step;
+			if (!velocity.IsZero()) {
+				next.vel = velocity;
+				next.vel.Normalize();
+				next.dir = Unit::GetDirection(next.vel);
+			}
+			predictions.Clear();
+			FillPredictions(predictions, next, target, units.speed[i], step);
+		}
+		else {
+			// push the next step after the last one
+			const Pred_Pos* last = predictions.Back();
+			predictions.PushBack(Unit::PredictStep(last != nullptr ? *last : next, target, units.speed[i], step));
+		}
+
+		units.nextPosition[i] = next.pos;
+		units.nextVelocity[i] = velocity;
+
+		if (next.pos.DistanceNoSqrt(target) < 4) {
+			predictions.Clear();
+			arrived.push_back(i);
+		}
 	}
+}
+
+// Closest units around index as seen last tick, only reads the current buffers so it is safe from any job
+uint EntityManager::GatherNeighbours(uint index, vector<Collider*>& found, AvoidanceAgent* neighbours) const
+{
+	const simPoint& position = units.position[index];
+
+	// colliders sit at the unit's feet, below its position, so the query is centred on ours
+	const Collider* self = App->collision->GetCollider(units.unit[index]->hard_collider);
+	iPoint center = (self != nullptr) ? self->pos : iPoint(RoundToInt(position.x), RoundToInt(position.y));
+	uint results = App->collision->QueryCircle(center, AVOIDANCE_RANGE, found.data(), found.size(), LAYER_HARD_UNITS);
+	uint count = 0;
+	simScalar farthest = simScalar(0);
+	uint farthest_index = 0;
+
+	for (uint i = 0; i < results; i++) {
+		// skip ourselves and units already removed this frame
+		const Unit* unit = found[i]->GetUnit();
+		if (unit == nullptr || unit->simIndex == index)
+			continue;
+
+		uint other = unit->simIndex;
+
+		simScalar dist = position.DistanceNoSqrt(units.position[other]);
+
+		if (count == MAX_AVOIDANCE_NEIGHBOURS) {
+			// full, replace the farthest one if this is closer
+			if (dist >= farthest)
+				continue;
+		}
+		else
+			farthest_index = count++;
+
+		AvoidanceAgent& agent = neighbours[farthest_index];
+		agent.position = units.position[other];
+		agent.velocity = units.velocity[other];
+		agent.radius = units.radius[other];
+		agent.responsibility = (units.state[other] == UNIT_MOVING) ? simScalar(0.5f) : simScalar(1);
+
+		if (count == MAX_AVOIDANCE_NEIGHBOURS) {
+			farthest = simScalar(0);
+			for (uint j = 0; j < count; j++) {
+				simScalar d = position.DistanceNoSqrt(neighbours[j].position);
+				if (d >= farthest) {
+					farthest = d;
+					farthest_index = j;
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
+// Places units between their last two simulated positions, alpha is how far into the
+// current tick the frame is rendered
+void EntityManager::InterpolationPass(float alpha)
+{
+	for (uint i = 0; i < units.Count(); i++) {
+		fPoint from(ToFloat(units.nextPosition[i].x), ToFloat(units.nextPosition[i].y));
+		fPoint to(ToFloat(units.position[i].x), ToFloat(units.position[i].y));
+
+		units.unit[i]->entityPosition.x = RoundToInt(from.x + (to.x - from.x) * alpha);
+		units.unit[i]->entityPosition.y = RoundToInt(from.y + (to.y - from.y) * alpha);
+	}
+}
+
+// Deterministic builds don't interpolate, entityPosition is read by path searches and collisions
+// so it has to be the simulated position itself
+void EntityManager::SnapPass()
+{
+	for (uint i = 0; i < units.Count(); i++) {
+		units.unit[i]->entityPosition.x = RoundToInt(units.position[i].x);
+		units.unit[i]->entityPosition.y = RoundToInt(units.position[i].y);
+	}
+}
+
+// Classifies every velocity in one go, animations only change for moving units that turned
+void EntityManager::DirectionPass()
+{
+	uint count = units.Count();
+	if (count == 0)
+		return;
+
+	newDirections.resize(count);
+	Unit::GetDirections(&units.velocity[0], &newDirections[0], count);
+
+	for (uint i = 0; i < count; i++) {
+
+		if (units.state[i] != UNIT_MOVING || units.velocity[i].IsZero() || newDirections[i] == units.direction[i])
+			continue;
+
+		units.direction[i] = newDirections[i];
+		units.anim[i].Play(units.archetype[i]->firstClip[units.state[i]] + newDirections[i]);
+	}
+}
+
+// Idle and fighting units pick the nearest enemy in sight, chase it and hit it once in reach.
+// Units walking on an order ignore enemies. Hits are collected and applied at the end.
+void EntityManager::CombatPass(simScalar step)
+{
+	damageEvents.clear();
+
+	for (uint i = 0; i < units.Count(); i++) {
+
+		unitState state = units.state[i];
+		if (state == UNIT_DEAD)
+			continue;
+
+		Unit* unit = units.unit[i];
+		Unit* target = GetUnit(unit->attackUnitTarget);
+		bool engaged = (target != nullptr && target->GetState() != UNIT_DEAD);
+
+		if (state == UNIT_MOVING && !engaged)
+			continue;
+
+		// idle units scan on the same staggered schedule, only a target that just died is replaced right away
+		bool retarget = ((tick + i) % COMBAT_RETARGET_INTERVAL == 0);
+		bool lost = (!engaged && !unit->attackUnitTarget.IsNull());
+
+		if (retarget || lost) {
+			target = FindNearestEnemy(i);
+			unit->attackUnitTarget = (target != nullptr) ? target->handle : EntityHandle();
+		}
+		else if (!engaged)
+			target = nullptr;
+
+		if (target == nullptr) {
+			if (state != UNIT_IDLE)
+				unit->SetState(UNIT_IDLE);
+			continue;
+		}
+
+		uint t = target->simIndex;
+		simPoint to_target = units.position[t] - units.position[i];
+		simScalar reach = units.radius[i] + units.radius[t] + COMBAT_MELEE_REACH;
+
+		if (to_target.DistanceNoSqrt(simPoint(0, 0)) <= reach * reach) {
+			if (state != UNIT_ATTACKING) {
+				unit->path.clear();
+				unit->SetState(UNIT_ATTACKING);
+			}
+
+			unitDirection dir = Unit::GetDirection(to_target);
+			if (dir != units.direction[i]) {
+				units.direction[i] = dir;
+				unit->SetAnim(dir);
+			}
+
+			if (unit->Attack(step)) {
+				DamageEvent hit = { target->handle, unit->GetDamageAgainst(target) };
+				damageEvents.push_back(hit);
+			}
+		}
+		else if (state != UNIT_MOVING || retarget) {
+			unit->Chase(App->map->WorldToMap(target->entityPosition.x, target->entityPosition.y));
+		}
+	}
+
+	ResolveDamage();
+}
+
+// Closest living enemy within the unit's line of sight
+Unit* EntityManager::FindNearestEnemy(uint index)
+{
+	const UnitArchetype* archetype = units.archetype[index];
+	uint32 enemies = (archetype->faction == FREE_MEN_UNIT) ? LAYER_HARD_SAURON_ARMY : LAYER_HARD_FREE_MEN;
+	int sight = archetype->lineOfSight * App->map->data.tile_width;
+
+	const simPoint& position = units.position[index];
+	uint found = App->collision->QueryCircle(iPoint(RoundToInt(position.x), RoundToInt(position.y)), sight, queryResults, MAX_QUERY_RESULTS, enemies);
+
+	Unit* nearest = nullptr;
+	simScalar nearest_dist = simScalar(0);
+
+	for (uint i = 0; i < found; i++) {
+		Unit* enemy = queryResults[i]->GetUnit();
+		if (enemy == nullptr || units.state[enemy->simIndex] == UNIT_DEAD)
+			continue;
+
+		simScalar dist = position.DistanceNoSqrt(units.position[enemy->simIndex]);
+		if (nearest == nullptr || dist < nearest_dist) {
+			nearest = enemy;
+			nearest_dist = dist;
+		}
+	}
+
+	return nearest;
+}
+
+// Hits on the same target are summed up so each target is looked up once
+void EntityManager::ResolveDamage()
+{
+	std::sort(damageEvents.begin(), damageEvents.end());
+
+	for (uint begin = 0, end = 0; begin < damageEvents.size(); begin = end) {
+
+		int damage = 0;
+		for (end = begin; end < damageEvents.size() && damageEvents[end].target == damageEvents[begin].target; end++)
+			damage += damageEvents[end].damage;
+
+		Unit* target = GetUnit(damageEvents[begin].target);
+		if (target == nullptr || target->GetState() == UNIT_DEAD)
+			continue;
+
+		target->unitLife -= damage;
+
+		if (target->unitLife <= 0) {
+			target->unitLife = 0;
+			target->attackUnitTarget = EntityHandle();
+			target->path.clear();
+			target->Dead();
+		}
+	}
+}
+
+// Only units that changed tile move their sight in the fog, then units the player
+// can't see are hidden
+void EntityManager::VisibilityPass()
+{
+	for (uint i = 0; i < units.Count(); i++) {
+		const iPoint& pos = units.unit[i]->entityPosition;
+		iPoint tile = App->map->WorldToMap(pos.x, pos.y);
+		int radius = units.archetype[i]->lineOfSight;
+
+		if (tile == units.sightTile[i] && radius == units.sightRadius[i])
+			continue;
+
+		uint faction = units.archetype[i]->faction;
+
+		if (units.sightRadius[i] >= 0)
+			App->fog->RemoveSight(faction, units.sightTile[i], units.sightRadius[i]);
+
+		App->fog->AddSight(faction, tile, radius);
+		units.sightTile[i] = tile;
+		units.sightRadius[i] = radius;
+	}
+
+	for (uint i = 0; i < units.Count(); i++) {
+		units.unit[i]->isVisible = (units.archetype[i]->faction == App->fog->player_faction) ||
+			App->fog->IsVisible(units.sightTile[i]);
+	}
+}
+
+// Units around the camera, selected or fighting run at full rate, the rest are reduced
+void EntityManager::LODPass()
+{
+	const SDL_Rect& camera = App->render->camera;
+	float left = -camera.x - LOD_VIEW_MARGIN;
+	float top = -camera.y - LOD_VIEW_MARGIN;
+	float right = -camera.x + camera.w + LOD_VIEW_MARGIN;
+	float bottom = -camera.y + camera.h + LOD_VIEW_MARGIN;
+
+	for (uint i = 0; i < units.Count(); i++) {
+		fPoint pos(ToFloat(units.position[i].x), ToFloat(units.position[i].y));
+		bool in_view = pos.x >= left && pos.x <= right && pos.y >= top && pos.y <= bottom;
+
+		unitLOD lod = (in_view || units.unit[i]->isSelected || units.state[i] == UNIT_ATTACKING) ? LOD_FULL : LOD_REDUCED;
+
+		// predictions were made with the old step length
+		if (lod != units.lod[i]) {
+			units.lod[i] = lod;
+			units.predictions[i].Clear();
+		}
+	}
+}
+
+// Off-screen units keep their frame, except dying ones so they still get removed
+void EntityManager::AnimationPass()
+{
+	finishedDying.clear();
+
+	for (uint i = 0; i < units.Count(); i++) {
+		if (units.lod[i] == LOD_REDUCED && units.state[i] != UNIT_DEAD)
+			continue;
+
+		AnimationPlayhead& anim = units.anim[i];
+		anim.GetCurrentFrame(units.archetype[i]->clips[anim.clip]);
+
+#ifndef DETERMINISTIC_SIMULATION
+		if (units.state[i] == UNIT_DEAD && anim.Finished())
+			finishedDying.push_back(units.unit[i]);
+#endif
+	}
+
+	for (uint i = 0; i < finishedDying.size(); i++)
+		DeleteUnit(finishedDying[i]);
+}
+
+// Dead units are removed on the tick their death clip is over, not on the frame it finishes drawing
+void EntityManager::CorpsePass(simScalar step)
+{
+	finishedDying.clear();
+
+	for (uint i = 0; i < units.Count(); i++) {
+		if (units.state[i] == UNIT_DEAD && units.unit[i]->Decay(step))
+			finishedDying.push_back(units.unit[i]);
+	}
+
+	for (uint i = 0; i < finishedDying.size(); i++)
+		DeleteUnit(finishedDying[i]);
+}
+
+bool EntityManager::PostUpdate()
+{
+	for (uint i = 0; i < pendingDestroy.size(); i++) {
+		pendingDestroy[i]->Recycle();
+		freeUnits.push_back(pendingDestroy[i]);
+	}
+	pendingDestroy.clear();
 
 	return true;
 }
@@ -127,39 +937,301 @@ bool EntityManager::CleanUp()
 {
 	LOG("Freeing EntityManager");
 
-	for (list<Unit*>::iterator it = friendlyUnitList.begin(); it != friendlyUnitList.end(); it++) {
-		RELEASE((*it));
+	if (!App->IsReplaying() && recordFile.Length() > 0) {
+		commandLog.ticks = tick;
+		commandLog.Save(recordFile.GetString());
 	}
-	friendlyUnitList.clear();
+	commandLog.Clear();
+	pendingCommands.clear();
+
+	ReleaseUnits();
 
+	for (uint i = 0; i < unitBlocks.size(); i++)
+		RELEASE_ARRAY(unitBlocks[i]);
+	unitBlocks.clear();
+	freeUnits.clear();
+	WaypointQueue::ReleasePool();
 
-	for (list<Unit*>::iterator it = removeUnitList.begin(); it != removeUnitList.end(); it++) {
-		RELEASE((*it));
+	for (uint i = 0; i < archetypes.size(); i++) {
+		for (int j = 0; j < MAX_UNIT_ANIMATIONS; j++) {
+			if (archetypes[i].textures[j] != nullptr) {
+				App->tex->UnLoad(archetypes[i].textures[j]);
+				archetypes[i].textures[j] = nullptr;
+			}
+		}
 	}
-	removeUnitList.clear();
 
 	return true;
 }
 
-Unit* EntityManager::CreateUnit(int posX, int posY, bool isEnemy, unitType type)
+void EntityManager::ReleaseUnits()
+{
+	selectedUnitList.clear();
+
+	// deleted units gave their colliders back already
+	for (uint i = 0; i < units.Count(); i++) {
+		App->collision->DeleteCollider(units.unit[i]->soft_collider);
+		App->collision->DeleteCollider(units.unit[i]->hard_collider);
+		pendingDestroy.push_back(units.unit[i]);
+	}
+	units.Clear();
+
+	for (uint i = 0; i < pendingDestroy.size(); i++) {
+		pendingDestroy[i]->Recycle();
+		freeUnits.push_back(pendingDestroy[i]);
+	}
+	pendingDestroy.clear();
+}
+
+void EntityManager::ReserveUnits(uint count)
+{
+	while (freeUnits.size() < count) {
+		Unit* block = new Unit[UNIT_POOL_BLOCK];
+		unitBlocks.push_back(block);
+
+		// backwards, so units are handed out in address order
+		for (int i = UNIT_POOL_BLOCK - 1; i >= 0; i--)
+			freeUnits.push_back(&block[i]);
+	}
+
+	units.Reserve(units.Count() + count);
+	App->collision->Reserve(count * 2);
+}
+
+Unit* EntityManager::SpawnUnit(int posX, int posY, bool isEnemy, const UnitArchetype* archetype)
 {
-	Unit* unit = new Unit(posX, posY, isEnemy, type);
+	ReserveUnits(1);
+
+	Unit* unit = freeUnits.back();
+	freeUnits.pop_back();
+
+	unit->Spawn(posX, posY, isEnemy, archetype);
 	unit->entityID = nextID;
 	nextID++;
 
-	friendlyUnitList.push_back(unit);
+	return unit;
+}
+
+// What CreateUnit needs to build a saved unit again
+struct SnapshotSpawn
+{
+	unitType type;
+	bool isEnemy;
+	iPoint position;
+};
+
+bool EntityManager::LoadSnapshot(SnapshotReader& data)
+{
+	// the whole chunk is read and checked before anything changes, a bad snapshot leaves the match as it was
+	uint saved_tick = 0, count = 0;
+	int saved_next_id = 0;
+	formationType saved_formation = formation;
 
+	data.Read(saved_tick);
+	data.Read(saved_next_id);
+	data.Read(saved_formation);
+	data.Read(count);
 
-	return unit;
+	if (data.Failed() || count > data.Remaining()) {
+		LOG("Snapshot units are truncated");
+		return false;
+	}
+
+	vector<SnapshotSpawn> spawns(count);
+	for (uint i = 0; i < count; i++) {
+		data.Read(spawns[i].type);
+		data.Read(spawns[i].isEnemy);
+		data.Read(spawns[i].position);
+
+		if (data.Failed() || GetArchetype(spawns[i].type) == nullptr) {
+			LOG("Snapshot unit %d can't be built", i);
+			return false;
+		}
+	}
+
+	UnitArrays saved;
+	bool ret = data.ReadArray(saved.position) && data.ReadArray(saved.velocity) &&
+		data.ReadArray(saved.nextPosition) && data.ReadArray(saved.nextVelocity) &&
+		data.ReadArray(saved.state) && data.ReadArray(saved.waypoint) &&
+		data.ReadArray(saved.speed) && data.ReadArray(saved.radius) &&
+		data.ReadArray(saved.direction) && data.ReadArray(saved.predictions) &&
+		data.ReadArray(saved.anim) && data.ReadArray(saved.lod) &&
+		data.ReadArray(saved.sightTile) && data.ReadArray(saved.sightRadius) &&
+		data.ReadArray(saved.slots) && data.ReadArray(saved.freeSlots);
+
+	ret = ret && saved.position.size() == count && saved.velocity.size() == count &&
+		saved.nextPosition.size() == count && saved.nextVelocity.size() == count &&
+		saved.state.size() == count && saved.waypoint.size() == count &&
+		saved.speed.size() == count && saved.radius.size() == count &&
+		saved.direction.size() == count && saved.predictions.size() == count &&
+		saved.anim.size() == count && saved.lod.size() == count &&
+		saved.sightTile.size() == count && saved.sightRadius.size() == count &&
+		saved.slots.size() >= count;
+
+	for (uint i = 0; i < saved.freeSlots.size() && ret; i++)
+		ret = saved.freeSlots[i] < saved.slots.size();
+
+	// each unit's own block is prefixed with its size
+	vector<SnapshotReader> unitData;
+	unitData.reserve(count);
+	for (uint i = 0; i < count && ret; i++) {
+		uint size = 0;
+		data.Read(size);
+		unitData.push_back(data.Split(size));
+		ret = !data.Failed();
+	}
+
+	if (ret == false) {
+		LOG("Snapshot unit arrays don't match its %d units", count);
+		return false;
+	}
+
+	// a recorded log can't rewind with the match, the recording ends here
+	if (!App->IsReplaying()) {
+		if (recordFile.Length() > 0) {
+			LOG("Loaded a snapshot while recording, the command log of this match won't be saved");
+			recordFile.Clear();
+		}
+		commandLog.Clear();
+	}
+
+	// colliders and fog come back with their own modules, whatever ours did to them is overwritten
+	ReleaseUnits();
+	pendingCommands.clear();
+	ReserveUnits(count);
+
+	for (uint i = 0; i < count; i++)
+		SpawnUnit(spawns[i].position.x, spawns[i].position.y, spawns[i].isEnemy, GetArchetype(spawns[i].type));
+
+	units.position.swap(saved.position);
+	units.velocity.swap(saved.velocity);
+	units.nextPosition.swap(saved.nextPosition);
+	units.nextVelocity.swap(saved.nextVelocity);
+	units.state.swap(saved.state);
+	units.waypoint.swap(saved.waypoint);
+	units.speed.swap(saved.speed);
+	units.radius.swap(saved.radius);
+	units.direction.swap(saved.direction);
+	units.predictions.swap(saved.predictions);
+	units.anim.swap(saved.anim);
+	units.lod.swap(saved.lod);
+	units.sightTile.swap(saved.sightTile);
+	units.sightRadius.swap(saved.sightRadius);
+	units.slots.swap(saved.slots);
+	units.freeSlots.swap(saved.freeSlots);
+
+	tick = saved_tick;
+	nextID = saved_next_id;
+	formation = saved_formation;
+
+	for (uint i = 0; i < count; i++) {
+		if (units.unit[i]->LoadSnapshot(unitData[i]) == false || unitData[i].Remaining() != 0) {
+			LOG("Snapshot unit %d is corrupt, the units are only partly loaded", i);
+			return false;
+		}
+
+		if (units.unit[i]->isSelected)
+			selectedUnitList.push_back(units.unit[i]);
+	}
+
+	return true;
+}
+
+bool EntityManager::SaveSnapshot(SnapshotWriter& data) const
+{
+	data.Write(tick);
+	data.Write(nextID);
+	data.Write(formation);
+	data.Write(units.Count());
+
+	// what CreateUnit needs to build each unit again
+	for (uint i = 0; i < units.Count(); i++) {
+		data.Write(units.unit[i]->GetType());
+		data.Write(units.unit[i]->IsEnemy());
+		data.Write(units.unit[i]->entityPosition);
+	}
+
+	data.WriteArray(units.position);
+	data.WriteArray(units.velocity);
+	data.WriteArray(units.nextPosition);
+	data.WriteArray(units.nextVelocity);
+	data.WriteArray(units.state);
+	data.WriteArray(units.waypoint);
+	data.WriteArray(units.speed);
+	data.WriteArray(units.radius);
+	data.WriteArray(units.direction);
+	data.WriteArray(units.predictions);
+	data.WriteArray(units.anim);
+	data.WriteArray(units.lod);
+	data.WriteArray(units.sightTile);
+	data.WriteArray(units.sightRadius);
+	data.WriteArray(units.slots);
+	data.WriteArray(units.freeSlots);
+
+	for (uint i = 0; i < units.Count(); i++) {
+		uint size_offset = data.Size();
+		data.Write((uint)0);
+		units.unit[i]->SaveSnapshot(data);
+		data.Patch(size_offset, data.Size() - size_offset - (uint)sizeof(uint));
+	}
+
+	return true;
+}
+
+Unit* EntityManager::CreateUnit(int posX, int posY, bool isEnemy, unitType type)
+{
+	const UnitArchetype* archetype = GetArchetype(type);
+	if (archetype == nullptr)
+		return nullptr;
+
+	return SpawnUnit(posX, posY, isEnemy, archetype);
+}
+
+uint EntityManager::CreateUnits(unitType type, const iPoint* positions, uint count, bool isEnemy, Unit** created)
+{
+	const UnitArchetype* archetype = GetArchetype(type);
+	if (archetype == nullptr)
+		return 0;
+
+	ReserveUnits(count);
+
+	for (uint i = 0; i < count; i++) {
+		Unit* unit = SpawnUnit(positions[i].x, positions[i].y, isEnemy, archetype);
+		if (created != nullptr)
+			created[i] = unit;
+	}
+
+	return count;
 }
 
 
-void EntityManager::DeleteUnit(Unit* unit, bool isEnemy)
+Unit* EntityManager::GetUnit(EntityHandle handle) const
+{
+	return units.Get(handle);
+}
+
+void EntityManager::DeleteUnit(Unit* unit)
 {
-	if (unit != nullptr) {
-		removeUnitList.push_back(unit);
-		friendlyUnitList.remove(unit);
+	// already deleted units have a stale handle
+	if (unit == nullptr || units.Get(unit->handle) != unit)
+		return;
+
+	if (unit->isSelected) {
+		vector<Unit*>::iterator it = std::find(selectedUnitList.begin(), selectedUnitList.end(), unit);
+		*it = selectedUnitList.back();
+		selectedUnitList.pop_back();
 	}
+
+	uint index = unit->simIndex;
+	if (units.sightRadius[index] >= 0)
+		App->fog->RemoveSight(units.archetype[index]->faction, units.sightTile[index], units.sightRadius[index]);
+
+	units.Remove(index);
+	pendingDestroy.push_back(unit);
+
+	// colliders go now rather than with the unit at the end of the frame
+	App->collision->DeleteCollider(unit->soft_collider);
+	App->collision->DeleteCollider(unit->hard_collider);
 }
 
 void EntityManager::OnCollision(Collider * c1, Collider * c2)
@@ -167,8 +1239,10 @@ void EntityManager::OnCollision(Collider * c1, Collider * c2)
 	c1->colliding = true; c2->colliding = true;
 	Unit* unit_to_move = c1->GetUnit(); Unit* unit2 = c2->GetUnit();
 	// if buildings are added, here it should be checked if c1 and c2 belong to units before continuing
+	if (unit_to_move == nullptr || unit2 == nullptr)
+		return;
 
-	if (unit_to_move->state == UNIT_MOVING && unit2->state == UNIT_IDLE) {
+	if (unit_to_move->GetState() == UNIT_MOVING && unit2->GetState() == UNIT_IDLE) {
 
 		if (!unit_to_move->path.empty())
 			unit_to_move->path.pop_front();
@@ -178,21 +1252,16 @@ void EntityManager::OnCollision(Collider * c1, Collider * c2)
 	}
 }
 
-
-void EntityManager::DestroyEntity(Entity * entity)
+void EntityManager::OnPredictedCollision(Collider * c1, Collider * c2, float toi)
 {
-	if (entity != nullptr) {
-		list<Unit*>::iterator it = removeUnitList.begin();
+	// soft colliders are allowed to overlap, only hard ones block the way
+	if (c1->type != HARD_COLLIDER || c2->type != HARD_COLLIDER)
+		return;
 
-		while (it != removeUnitList.end())
-		{
-			if (*it == entity)
-			{
-				removeUnitList.remove(*it);
-				delete entity;
-				return;
-			}
-			++it;
-		}
-	}
+	Unit* unit_to_move = c1->GetUnit(); Unit* unit2 = c2->GetUnit();
+	if (unit_to_move == nullptr || unit2 == nullptr)
+		return;
+
+	if (unit_to_move->GetState() == UNIT_MOVING && unit2->GetState() == UNIT_IDLE)
+		unit_to_move->Detour(App->pathfinding->FindNearestAvailable(unit_to_move));
 }
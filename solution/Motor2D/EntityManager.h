@@ -5,9 +5,244 @@
 #include "j1Module.h"
 #include "Entity.h"
 #include "Unit.h"
+#include "Avoidance.h"
+#include "Formation.h"
+#include "CommandLog.h"
+#include "p2SString.h"
+
+#define MAX_QUERY_RESULTS 512
+// How far, in pixels, from the cursor a clicked unit's collider may be, it sits below the sprite
+#define SELECTION_PICK_RANGE 128
+#define UNITS_PER_MOVEMENT_JOB 256
+// Units out of view move every this many ticks, with a step as long as the ticks they skipped
+#define LOD_REDUCED_INTERVAL 4
+// How far outside the camera, in pixels, a unit still counts as in view
+#define LOD_VIEW_MARGIN 128
+// Units look for an enemy, or a closer one, every this many ticks, staggered over the units
+#define COMBAT_RETARGET_INTERVAL 8
+// Extra distance, in pixels, between two collider edges a melee hit still reaches
+#define COMBAT_MELEE_REACH 12
+// Move orders run one path search per square region of this many tiles the units start in
+#define ORDER_REGION_SIZE 8
+// How far away from its formation slot, in tiles, a unit may end up when the slot is blocked
+#define FORMATION_SEARCH_RADIUS 4
+// Avoidance looks this far around a unit, in pixels, and this far ahead, in seconds
+#define AVOIDANCE_RANGE 64
+#define AVOIDANCE_TIME_HORIZON 1.0f
+#define AVOIDANCE_QUERY_RESULTS 32
+// Pooled units are allocated this many at a time
+#define UNIT_POOL_BLOCK 256
 
 class Entity;
 
+// A hit waiting to be applied, all of a tick's hits are resolved together
+struct DamageEvent
+{
+	EntityHandle target;
+	int damage;
+
+	bool operator <(const DamageEvent& e) const
+	{
+		return target < e.target;
+	}
+};
+
+// A unit of a move order and the region it starts in, sorting groups the regions together
+struct OrderEntry
+{
+	uint64 region;
+	uint unit;
+
+	bool operator <(const OrderEntry& e) const
+	{
+		return (region != e.region) ? region < e.region : unit < e.unit;
+	}
+};
+
+// Hot unit data laid out one array per field so the per frame passes stream through
+// memory. Unit i owns index i of every array, removing swaps the last unit into the hole.
+// Handles go through slots, which know where their unit lives now and which generation it is.
+// Position and velocity are double buffered: the movement pass reads last tick's values
+// and writes next*, then SwapBuffers publishes them, so jobs never see a half updated tick.
+// After the swap next* holds the previous tick, which rendering interpolates from.
+struct UnitArrays
+{
+	vector<Unit*> unit;
+	vector<simPoint> position;
+	vector<simPoint> velocity;
+	vector<simPoint> nextPosition;
+	vector<simPoint> nextVelocity;
+	vector<unitState> state;
+	vector<simPoint> waypoint;
+	vector<simScalar> speed;
+	vector<simScalar> radius;
+	vector<unitDirection> direction;
+	vector<PredictionQueue> predictions;
+	vector<AnimationPlayhead> anim;
+	vector<const UnitArchetype*> archetype;
+	vector<unitLOD> lod;
+	// tile and radius the unit's sight is stamped with in the fog, -1 radius when it isn't
+	vector<iPoint> sightTile;
+	vector<int> sightRadius;
+
+	vector<p2HandleSlot> slots;
+	vector<uint> freeSlots;
+
+	uint Count() const
+	{
+		return unit.size();
+	}
+
+	Unit* Get(EntityHandle handle) const
+	{
+		if (handle.IsNull() || handle.index >= slots.size() || slots[handle.index].generation != handle.generation)
+			return nullptr;
+
+		return unit[slots[handle.index].dense];
+	}
+
+	// gives new_unit its handle, returns its index in the arrays
+	uint Add(Unit* new_unit, const UnitArchetype* unit_archetype, const simPoint& pos)
+	{
+		uint slot;
+		if (freeSlots.empty() == false) {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else {
+			slot = slots.size();
+			slots.push_back(p2HandleSlot());
+		}
+
+		slots[slot].dense = unit.size();
+		new_unit->handle.index = slot;
+		new_unit->handle.generation = slots[slot].generation;
+
+		unit.push_back(new_unit);
+		position.push_back(pos);
+		velocity.push_back(simPoint(0, 0));
+		nextPosition.push_back(pos);
+		nextVelocity.push_back(simPoint(0, 0));
+		state.push_back(UNIT_IDLE);
+		waypoint.push_back(pos);
+		speed.push_back(simScalar(unit_archetype->movementSpeed));
+		radius.push_back(simScalar(0));
+		direction.push_back(DOWN_LEFT);
+		predictions.push_back(PredictionQueue());
+		anim.push_back(AnimationPlayhead());
+		archetype.push_back(unit_archetype);
+		lod.push_back(LOD_FULL);
+		sightTile.push_back(iPoint(0, 0));
+		sightRadius.push_back(-1);
+
+		return unit.size() - 1;
+	}
+
+	// room for count units in total, at least doubling so batch after batch doesn't reallocate
+	void Reserve(uint count)
+	{
+		if (count <= unit.capacity())
+			return;
+
+		count = MAX(count, (uint)unit.capacity() * 2);
+		unit.reserve(count);
+		position.reserve(count);
+		velocity.reserve(count);
+		nextPosition.reserve(count);
+		nextVelocity.reserve(count);
+		state.reserve(count);
+		waypoint.reserve(count);
+		speed.reserve(count);
+		radius.reserve(count);
+		direction.reserve(count);
+		predictions.reserve(count);
+		anim.reserve(count);
+		archetype.reserve(count);
+		lod.reserve(count);
+		sightTile.reserve(count);
+		sightRadius.reserve(count);
+		slots.reserve(count);
+		freeSlots.reserve(count);
+	}
+
+	// the unit's handle goes stale right away
+	void Remove(uint index)
+	{
+		uint last = unit.size() - 1;
+
+		p2HandleSlot& slot = slots[unit[index]->handle.index];
+		if (++slot.generation == 0)
+			slot.generation = 1;
+		freeSlots.push_back(unit[index]->handle.index);
+
+		if (index != last) {
+			unit[index] = unit[last];
+			position[index] = position[last];
+			velocity[index] = velocity[last];
+			nextPosition[index] = nextPosition[last];
+			nextVelocity[index] = nextVelocity[last];
+			state[index] = state[last];
+			waypoint[index] = waypoint[last];
+			speed[index] = speed[last];
+			radius[index] = radius[last];
+			direction[index] = direction[last];
+			predictions[index] = predictions[last];
+			anim[index] = anim[last];
+			archetype[index] = archetype[last];
+			lod[index] = lod[last];
+			sightTile[index] = sightTile[last];
+			sightRadius[index] = sightRadius[last];
+			unit[index]->simIndex = index;
+			slots[unit[index]->handle.index].dense = index;
+		}
+
+		unit.pop_back();
+		position.pop_back();
+		velocity.pop_back();
+		nextPosition.pop_back();
+		nextVelocity.pop_back();
+		state.pop_back();
+		waypoint.pop_back();
+		speed.pop_back();
+		radius.pop_back();
+		direction.pop_back();
+		predictions.pop_back();
+		anim.pop_back();
+		archetype.pop_back();
+		lod.pop_back();
+		sightTile.pop_back();
+		sightRadius.pop_back();
+	}
+
+	void SwapBuffers()
+	{
+		position.swap(nextPosition);
+		velocity.swap(nextVelocity);
+	}
+
+	void Clear()
+	{
+		slots.clear();
+		freeSlots.clear();
+		unit.clear();
+		position.clear();
+		velocity.clear();
+		nextPosition.clear();
+		nextVelocity.clear();
+		state.clear();
+		waypoint.clear();
+		speed.clear();
+		radius.clear();
+		direction.clear();
+		predictions.clear();
+		anim.clear();
+		archetype.clear();
+		lod.clear();
+		sightTile.clear();
+		sightRadius.clear();
+	}
+};
+
 class EntityManager : public j1Module {
 public:
 	EntityManager();
@@ -24,6 +259,9 @@ public:
 	// Called before all Updates
 	bool PreUpdate();
 
+	// Advance the unit simulation one tick
+	bool FixedUpdate(float step);
+
 	// Update Elements
 	bool Update(float dt);
 
@@ -33,26 +271,122 @@ public:
 	// Called before quitting
 	bool CleanUp();
 
+	// Units are built again in the saved order, then the unit arrays are copied over them
+	bool LoadSnapshot(SnapshotReader&);
+	bool SaveSnapshot(SnapshotWriter&) const;
+
 	Unit* CreateUnit(int posX, int posY, bool isEnemy, unitType type);
+	// Spawns count units of type at positions, in world pixels. Pooled units, array and collider
+	// room for all of them is made up front. created, if given, gets the new units
+	uint CreateUnits(unitType type, const iPoint* positions, uint count, bool isEnemy, Unit** created = nullptr);
+	const UnitArchetype* GetArchetype(unitType type);
 	bool IsOccupied(iPoint tile, Unit* ignore_unit = NULL);
 
-	void DeleteUnit(Unit* unit, bool isEnemy);
+	// Sends group to target in formation. Units are bucketed by the region they start in,
+	// one path is planned per region for the unit closest to its center and the rest
+	// follow it offset by their formation slot
+	void MoveGroup(const vector<Unit*>& group, const iPoint& target);
+
+	const vector<Unit*>& GetSelectedUnits() const;
+
+	// Orders are queued and run at the start of the next tick, every order that runs is logged
+	void IssueCommand(commandType type, const vector<Unit*>& group, const iPoint& destination);
+	// replays are over once the last recorded tick has run
+	bool ReplayFinished() const;
+
+	// nullptr if the unit has been deleted
+	Unit* GetUnit(EntityHandle handle) const;
+
+	// Takes the unit out of the simulation right away, it is destroyed at the end of the frame
+	void DeleteUnit(Unit* unit);
 	void OnCollision(Collider* c1, Collider* c2);
+	void OnPredictedCollision(Collider* c1, Collider* c2, float toi);
 
 private:
-	void DestroyEntity(Entity* entity);
+	bool LoadArchetypes();
+	// returns every unit to the pool at once, deleted ones included
+	void ReleaseUnits();
+	// makes sure count more units can spawn without allocating
+	void ReserveUnits(uint count);
+	Unit* SpawnUnit(int posX, int posY, bool isEnemy, const UnitArchetype* archetype);
+
+	// batched unit simulation, each pass walks the unit arrays once
+	void MovementPass(simScalar step);
+	void MoveUnits(uint begin, uint end, simScalar step, vector<uint>& arrived, vector<Collider*>& found);
+	uint GatherNeighbours(uint index, vector<Collider*>& found, AvoidanceAgent* neighbours) const;
+	void InterpolationPass(float alpha);
+	void SnapPass();
+	void LODPass();
+	void VisibilityPass();
+	void CombatPass(simScalar step);
+	void CorpsePass(simScalar step);
+	Unit* FindNearestEnemy(uint index);
+	void ResolveDamage();
+	void DirectionPass();
+	void AnimationPass();
+
+	void RunCommands();
+	void ExecuteCommand(const Command& command);
+
+	void HandleSelection();
+	void Select(Unit* unit);
+	void ClearSelection();
 
 private:
-	list<Unit*> friendlyUnitList;
-	list<Unit*> removeUnitList;
-	list<Unit*> selectedUnitList;
+	// deleted this frame, back to the pool in PostUpdate
+	vector<Unit*> pendingDestroy;
+	// units are allocated in blocks and recycled, never freed one by one
+	vector<Unit*> unitBlocks;
+	vector<Unit*> freeUnits;
+	// dense, every unit in it has isSelected set
+	vector<Unit*> selectedUnitList;
+	// indexed by unitType
+	vector<UnitArchetype> archetypes;
 	Unit* selectedUnit;
 	Building* selectedBuilding;
 	SDL_Rect multiSelectionRect = { 0,0,0,0 };
 	bool drawMultiSelectionRect;
 
+	// move order scratch buffers
+	vector<iPoint> formationSlots;
+	vector<iPoint> slotTiles;
+	vector<simPoint> slotPositions;
+	vector<simPoint> groupPositions;
+	vector<uint> slotAssignment;
+	vector<OrderEntry> orderEntries;
+	vector<iPoint> leaderPath;
+	vector<iPoint> unitPath;
+
+	// orders waiting for the next tick
+	vector<Command> pendingCommands;
+	vector<Unit*> commandUnits;
+	vector<Unit*> pickedUnits;
+	// camera position in the log, moving it changes which units run at reduced rate
+	iPoint loggedCamera;
+	// where the command log is saved on quit, nothing is saved when empty
+	p2SString recordFile;
+
+	// scratch buffer for collision queries
+	Collider* queryResults[MAX_QUERY_RESULTS];
+	// box selections, grows until a query fits
+	vector<Collider*> selectionResults;
+
+	// units collected by the passes and handled once they are over
+	vector<vector<uint>> workerArrivals;
+	vector<vector<Collider*>> workerNeighbours;
+	vector<Unit*> arrivals;
+	vector<Unit*> finishedDying;
+	vector<unitDirection> newDirections;
+	vector<DamageEvent> damageEvents;
+
+	// simulation ticks so far, staggers the reduced rate units
+	uint tick = 0;
+
 public:
 	int nextID;
+	formationType formation = FORMATION_BOX;
+	UnitArrays units;
+	CommandLog commandLog;
 
 };
 
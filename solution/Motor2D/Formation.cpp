@@ -0,0 +1,176 @@
+#include "Formation.h"
+#include <algorithm>
+
+// Widest rank of a line formation, longer groups get more ranks behind it
+#define FORMATION_LINE_WIDTH 12
+
+// tan(22.5), beyond it the other axis counts for the direction
+#define FORMATION_OCTANT_SLOPE 0.41421356f
+
+static uint RowWidth(formationType type, uint row, uint count)
+{
+	switch (type) {
+	case FORMATION_LINE:
+		return MIN(count, FORMATION_LINE_WIDTH);
+	case FORMATION_BOX:
+	{
+		uint width = (uint)ISqrt(count);
+		return (width * width < count) ? width + 1 : width;
+	}
+	case FORMATION_WEDGE:
+		return row * 2 + 1;
+	}
+
+	return count;
+}
+
+void GenerateFormationSlots(formationType type, uint count, const iPoint& dir, std::vector<iPoint>& slots)
+{
+	slots.clear();
+
+	iPoint side(-dir.y, dir.x);
+	uint row = 0;
+
+	while (slots.size() < count) {
+		int width = MIN(RowWidth(type, row, count), count - slots.size());
+
+		for (int column = -(width / 2); column < width - width / 2; column++)
+			slots.push_back(iPoint(side.x * column - dir.x * row, side.y * column - dir.y * row));
+
+		row++;
+	}
+
+	// center the ranks on the target
+	int shift = (row - 1) / 2;
+	for (uint i = 0; i < slots.size(); i++) {
+		slots[i].x += dir.x * shift;
+		slots[i].y += dir.y * shift;
+	}
+}
+
+iPoint FormationDirection(const simPoint& travel)
+{
+	simScalar ax = Abs(travel.x);
+	simScalar ay = Abs(travel.y);
+
+	iPoint dir(0, 0);
+	if (ax > simScalar(FORMATION_OCTANT_SLOPE) * ay)
+		dir.x = (travel.x > 0) ? 1 : -1;
+	if (ay > simScalar(FORMATION_OCTANT_SLOPE) * ax)
+		dir.y = (travel.y > 0) ? 1 : -1;
+
+	if (dir.IsZero())
+		dir.y = 1;
+
+	return dir;
+}
+
+// Kuhn-Munkres with potentials, O(n^3)
+static void AssignOptimal(const std::vector<simPoint>& units, const std::vector<simPoint>& slots, std::vector<uint>& assignment)
+{
+	uint n = units.size();
+	std::vector<simScalar> u(n + 1, simScalar(0)), v(n + 1, simScalar(0)), min_v(n + 1);
+	std::vector<uint> p(n + 1, 0), way(n + 1, 0);
+	std::vector<bool> used(n + 1);
+
+	for (uint i = 1; i <= n; i++) {
+		p[0] = i;
+		uint j0 = 0;
+		std::fill(min_v.begin(), min_v.end(), SIM_SCALAR_MAX);
+		std::fill(used.begin(), used.end(), false);
+
+		do {
+			used[j0] = true;
+			uint i0 = p[j0], j1 = 0;
+			simScalar delta = SIM_SCALAR_MAX;
+
+			for (uint j = 1; j <= n; j++) {
+				if (used[j])
+					continue;
+
+				simScalar cur = units[i0 - 1].DistanceTo(slots[j - 1]) - u[i0] - v[j];
+				if (cur < min_v[j]) {
+					min_v[j] = cur;
+					way[j] = j0;
+				}
+				if (min_v[j] < delta) {
+					delta = min_v[j];
+					j1 = j;
+				}
+			}
+
+			for (uint j = 0; j <= n; j++) {
+				if (used[j]) {
+					u[p[j]] += delta;
+					v[j] -= delta;
+				}
+				else
+					min_v[j] -= delta;
+			}
+
+			j0 = j1;
+		} while (p[j0] != 0);
+
+		// flip the augmenting path
+		do {
+			uint j1 = way[j0];
+			p[j0] = p[j1];
+			j0 = j1;
+		} while (j0 != 0);
+	}
+
+	for (uint j = 1; j <= n; j++)
+		assignment[p[j] - 1] = j - 1;
+}
+
+struct SlotCandidate
+{
+	simScalar distance;
+	uint unit;
+	uint slot;
+
+	bool operator <(const SlotCandidate& c) const
+	{
+		return distance < c.distance;
+	}
+};
+
+// Closest pairs first, not optimal but O(n^2 log n)
+static void AssignGreedy(const std::vector<simPoint>& units, const std::vector<simPoint>& slots, std::vector<uint>& assignment)
+{
+	uint n = units.size();
+	std::vector<SlotCandidate> candidates;
+	candidates.reserve(n * n);
+
+	for (uint i = 0; i < n; i++) {
+		for (uint j = 0; j < n; j++) {
+			SlotCandidate c = { units[i].DistanceNoSqrt(slots[j]), i, j };
+			candidates.push_back(c);
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+
+	std::vector<bool> unit_done(n, false), slot_taken(n, false);
+	uint assigned = 0;
+
+	for (uint i = 0; i < candidates.size() && assigned < n; i++) {
+		const SlotCandidate& c = candidates[i];
+		if (unit_done[c.unit] || slot_taken[c.slot])
+			continue;
+
+		assignment[c.unit] = c.slot;
+		unit_done[c.unit] = slot_taken[c.slot] = true;
+		assigned++;
+	}
+}
+
+void AssignFormationSlots(const std::vector<simPoint>& units, const std::vector<simPoint>& slots, std::vector<uint>& assignment)
+{
+	assignment.resize(units.size());
+
+	if (units.size() <= FORMATION_HUNGARIAN_MAX)
+		AssignOptimal(units, slots, assignment);
+	else
+		AssignGreedy(units, slots, assignment);
+}
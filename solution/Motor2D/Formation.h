@@ -0,0 +1,26 @@
+#ifndef __FORMATION_H__
+#define __FORMATION_H__
+
+#include "p2Fixed.h"
+#include "p2Defs.h"
+#include <vector>
+
+// Groups up to this size get an optimal slot assignment, bigger ones a greedy one
+#define FORMATION_HUNGARIAN_MAX 48
+
+enum formationType {
+	FORMATION_LINE, FORMATION_BOX, FORMATION_WEDGE
+};
+
+// Tile offsets of count slots around the target, front facing along dir. dir is one of the
+// eight tile directions, so row and column steps are integer and no two slots share a tile.
+void GenerateFormationSlots(formationType type, uint count, const iPoint& dir, std::vector<iPoint>& slots);
+
+// Snaps a travel vector to the closest of the eight tile directions
+iPoint FormationDirection(const simPoint& travel);
+
+// assignment[i] is the slot given to unit i, minimizing the total distance travelled.
+// units and slots must have the same size.
+void AssignFormationSlots(const std::vector<simPoint>& units, const std::vector<simPoint>& slots, std::vector<uint>& assignment);
+
+#endif // __FORMATION_H__
@@ -11,207 +11,100 @@
 #include "p2Defs.h"
 #include "j1Scene.h"
 #include "j1Gui.h"
+#include "p2Snapshot.h"
 
-Unit::Unit(int posX, int posY, bool isEnemy, unitType type)
+// Pooled units wait here until Spawn sets them up
+Unit::Unit() : simIndex(0), archetype(nullptr), attackBuildingTarget(nullptr), isVisible(false), isSelected(false)
+{}
+
+void Unit::Spawn(int posX, int posY, bool isEnemy, const UnitArchetype* archetype)
 {
+	this->archetype = archetype;
 	entityPosition.x = posX;
 	entityPosition.y = posY;
-	this->type = type;
-
-	pugi::xml_document gameDataFile;
-	pugi::xml_node gameData;
-	pugi::xml_node unitNodeInfo;
-
-	gameData = App->LoadGameData(gameDataFile);
-
-	if (gameData.empty() == false)
-	{
-		pugi::xml_node unit;
-		int i = 0;
-		for (unit = gameData.child("Units").child("Unit"); unit; unit = unit.next_sibling("Unit")) {
-			i++;
-			if (unit.child("Info").child("ID").attribute("value").as_int() == type) {
-				unitNodeInfo = unit;
-				break;
-			}
-			LOG("%d", unit.child("Info").child("ID").attribute("value").as_int());
-		}
-	}
-
-	string idleTexturePath = unitNodeInfo.child("Textures").child("Idle").attribute("value").as_string();
-	string moveTexturePath = unitNodeInfo.child("Textures").child("Move").attribute("value").as_string();
-	string attackTexturePath = unitNodeInfo.child("Textures").child("Attack").attribute("value").as_string();
-	string dieTexturePath = unitNodeInfo.child("Textures").child("Die").attribute("value").as_string();
+	this->isEnemy = isEnemy;
+	type = archetype->type;
 
-	faction = (unitFaction)unitNodeInfo.child("Stats").child("Faction").attribute("value").as_int();
-	attackSpeed = 1 / unitNodeInfo.child("Stats").child("AttackSpeed").attribute("value").as_float();
-	unitLife = unitNodeInfo.child("Stats").child("Life").attribute("value").as_int();
+	faction = archetype->faction;
+	// AttackSpeed is the time between hits in seconds
+	attackSpeed = simScalar(archetype->attackSpeed);
+	unitLife = archetype->life;
 	unitMaxLife = unitLife;
-	unitAttack = unitNodeInfo.child("Stats").child("Attack").attribute("value").as_int();
-	unitDefense = unitNodeInfo.child("Stats").child("Defense").attribute("value").as_int();
-	unitPiercingDamage = unitNodeInfo.child("Stats").child("PiercingDamage").attribute("value").as_int();
-	unitMovementSpeed = unitNodeInfo.child("Stats").child("MovementSpeed").attribute("value").as_float();
-
-	pugi::xml_node animationNode;
-	int width;
-	int height;
-	int rows;
-	int columns;
-
-	//Anim Idle//
-	animationNode = unitNodeInfo.child("Animations").child("Idle");
-	width = animationNode.child("Width").attribute("value").as_int();
-	height = animationNode.child("Height").attribute("value").as_int();
-	rows = animationNode.child("Rows").attribute("value").as_int();
-	columns = animationNode.child("Columns").attribute("value").as_int();
-	for (int i = 0; i < rows; i++) {
-		Animation idle;
-		for (int j = 0; j < columns; j++) {
-			idle.PushBack({ width*j,height*i,width,height });
-		}
-		idle.speed = animationNode.child("Speed").attribute("value").as_float();
-		idleAnimations.push_back(idle);
-		if (i != 0 && i != rows - 1) {
-			idle.flip = SDL_FLIP_HORIZONTAL;
-			idleAnimations.push_back(idle);
-		}
-	}
-
-	//Anim Moving//
-	animationNode = unitNodeInfo.child("Animations").child("Move");
-	width = animationNode.child("Width").attribute("value").as_int();
-	height = animationNode.child("Height").attribute("value").as_int();
-	rows = animationNode.child("Rows").attribute("value").as_int();
-	columns = animationNode.child("Columns").attribute("value").as_int();
-	for (int i = 0; i < rows; i++) {
-		Animation move;
-		for (int j = 0; j < columns; j++) {
-			move.PushBack({ width*j,height*i,width,height });
-		}
-		move.speed = animationNode.child("Speed").attribute("value").as_float();
-		movingAnimations.push_back(move);
-		if (i != 0 && i != rows - 1) {
-			move.flip = SDL_FLIP_HORIZONTAL;
-			movingAnimations.push_back(move);
-		}
-	}
+	unitAttack = archetype->attack;
+	unitDefense = archetype->defense;
+	unitPiercingDamage = archetype->piercingDamage;
 
-	//Anim Attacking//
-	animationNode = unitNodeInfo.child("Animations").child("Attack");
-	width = animationNode.child("Width").attribute("value").as_int();
-	height = animationNode.child("Height").attribute("value").as_int();
-	rows = animationNode.child("Rows").attribute("value").as_int();
-	columns = animationNode.child("Columns").attribute("value").as_int();
-	for (int i = 0; i < rows; i++) {
-		Animation attack;
-		for (int j = 0; j < columns; j++) {
-			attack.PushBack({ width*j,height*i,width,height });
-		}
-		attack.speed = animationNode.child("Speed").attribute("value").as_float();
-		attackingAnimations.push_back(attack);
-		if (i != 0 && i != rows - 1) {
-			attack.flip = SDL_FLIP_HORIZONTAL;
-			attackingAnimations.push_back(attack);
-		}
-	}
-
-	//Anim Dying//
-	animationNode = unitNodeInfo.child("Animations").child("Die");
-	width = animationNode.child("Width").attribute("value").as_int();
-	height = animationNode.child("Height").attribute("value").as_int();
-	rows = animationNode.child("Rows").attribute("value").as_int();
-	columns = animationNode.child("Columns").attribute("value").as_int();
-	for (int i = 0; i < rows; i++) {
-		Animation die;
-		for (int j = 0; j < columns; j++) {
-			die.PushBack({ width*j,height*i,width,height });
-		}
-		die.speed = animationNode.child("Speed").attribute("value").as_float();
-		dyingAnimations.push_back(die);
-		if (i != 0 && i != rows - 1) {
-			die.flip = SDL_FLIP_HORIZONTAL;
-			dyingAnimations.push_back(die);
-		}
-	}
+	simIndex = App->entityManager->units.Add(this, archetype, simPoint(posX, posY));
 
-	unitIdleTexture = App->tex->Load(idleTexturePath.c_str());
-	unitMoveTexture = App->tex->Load(moveTexturePath.c_str());
-	unitAttackTexture = App->tex->Load(attackTexturePath.c_str());
-	unitDieTexture = App->tex->Load(dieTexturePath.c_str());
+	unitIdleTexture = archetype->textures[UNIT_IDLE];
+	unitMoveTexture = archetype->textures[UNIT_MOVING];
+	unitAttackTexture = archetype->textures[UNIT_ATTACKING];
+	unitDieTexture = archetype->textures[UNIT_DEAD];
 
 	entityTexture = unitIdleTexture;
 
-	currentDirection = RIGHT; // starting direction
-	SetAnim(currentDirection);
+	SetAnim(App->entityManager->units.direction[simIndex]);
 
-	SDL_Rect r = currentAnim->GetCurrentFrame();
+	const SDL_Rect& r = GetAnim().GetActualFrame(GetCurrentClip());
 
 	iPoint col_pos(entityPosition.x, entityPosition.y + (r.h / 2));
-	COLLIDER_TYPE colliderType;
+	bool freeMen = (faction == FREE_MEN_UNIT);
 
-	colliderType = SOFT_COLLIDER;
-	soft_collider = App->collision->AddCollider(col_pos, 15, colliderType, (Entity*) this, App->entityManager);
-
-	colliderType = HARD_COLLIDER;
-	hard_collider = App->collision->AddCollider(col_pos, 8, colliderType, (Entity*) this, App->entityManager );
+	soft_collider = App->collision->AddCollider(col_pos, UNIT_SOFT_RADIUS, SOFT_COLLIDER, freeMen ? LAYER_SOFT_FREE_MEN : LAYER_SOFT_SAURON_ARMY, (Entity*) this, App->entityManager);
+	hard_collider = App->collision->AddCollider(col_pos, UNIT_HARD_RADIUS, HARD_COLLIDER, freeMen ? LAYER_HARD_FREE_MEN : LAYER_HARD_SAURON_ARMY, (Entity*) this, App->entityManager);
+	App->entityManager->units.radius[simIndex] = UNIT_HARD_RADIUS;
 
 	isSelected = false;
 	isVisible = true;
+	isActive = true;
+	timer = simScalar(0);
+	destinationTile.SetToZero();
+	attackUnitTarget = EntityHandle();
+	attackBuildingTarget = nullptr;
 
 	hpBarWidth = 40;
 }
 
-Unit::~Unit()
+// The unit's colliders and arrays are already gone, only the path's spilled block is left
+void Unit::Recycle()
 {
+	path.clear();
+	isActive = false;
+	isSelected = false;
+	archetype = nullptr;
 }
 
-bool Unit::Update(float dt)
+// EntityManager takes the colliders away when the unit is deleted, pooled units own none
+Unit::~Unit()
 {
-	switch (state) {
-	case UNIT_MOVING:
-		Move(dt);
-		break;
-	case UNIT_DEAD:
-		if (currentAnim->Finished()) {
-			App->entityManager->DeleteUnit(this, isEnemy);
-		}
-		break;
-	}
+}
 
-	if (App->input->GetMouseButtonDown(SDL_BUTTON_LEFT) == KEY_UP) {
-		int x;
-		int y;
-		App->input->GetMousePosition(x, y);
-		x -= App->render->camera.x;
-		y -= App->render->camera.y;
-		if (x < entityPosition.x + (hard_collider->r) && x > entityPosition.x - (hard_collider->r) &&
-			y < entityPosition.y + (hard_collider->r) && y > entityPosition.y - (hard_collider->r)) {
-			if (isVisible) {
-				isSelected = true;
-			}
-		}
-		else {
-			if (isSelected) {
-				isSelected = false;
-			}
-		}
-	}
 
-	return true;
+// Colliders follow the unit even when it isn't drawn
+void Unit::UpdateColliders()
+{
+	const SDL_Rect& r = GetAnim().GetActualFrame(GetCurrentClip());
+	iPoint col_pos(entityPosition.x, entityPosition.y + (r.h / 2));
+	Collider* soft = App->collision->GetCollider(soft_collider);
+	Collider* hard = App->collision->GetCollider(hard_collider);
+	soft->pos = col_pos;
+	hard->pos = col_pos;
+
+	// colliders sweep towards the end of the prediction horizon
+	const Pred_Pos* last = GetLastPrediction();
+	iPoint col_pred_pos = (last != nullptr) ? iPoint(RoundToInt(last->pos.x), RoundToInt(last->pos.y) + (r.h / 2)) : col_pos;
+	soft->pred_pos = col_pred_pos;
+	hard->pred_pos = col_pred_pos;
 }
 
-
 bool Unit::Draw()
 {
-	SDL_Rect r = currentAnim->GetCurrentFrame();
-	iPoint col_pos(entityPosition.x, entityPosition.y + (r.h / 2));
-	soft_collider->pos = col_pos;
-	hard_collider->pos = col_pos;
+	const SDL_Rect& r = GetAnim().GetActualFrame(GetCurrentClip());
 
 	if (isSelected) 
-		App->render->DrawCircle(col_pos.x, col_pos.y, 12, 255, 255, 255, 255);
+		App->render->DrawCircle(entityPosition.x, entityPosition.y + (r.h / 2), 12, 255, 255, 255, 255);
 
-	App->render->Blit(entityTexture, entityPosition.x - (r.w / 2), entityPosition.y - (r.h / 2), &r, currentAnim->flip);
+	App->render->Blit(entityTexture, entityPosition.x - (r.w / 2), entityPosition.y - (r.h / 2), &r, GetCurrentClip().flip);
 
 	return true;
 }
@@ -226,119 +119,175 @@ int Unit::GetLife() const
 	return unitLife;
 }
 
+unitState Unit::GetState() const
+{
+	return App->entityManager->units.state[simIndex];
+}
+
 void Unit::SetPos(int posX, int posY)
 {
 	entityPosition.x = posX;
 	entityPosition.y = posY;
+
+	// teleports skip interpolation
+	UnitArrays& units = App->entityManager->units;
+	units.position[simIndex] = units.nextPosition[simIndex] = simPoint(posX, posY);
 }
 
 void Unit::SetSpeed(int amount)
 {
-	unitMovementSpeed = amount;
+	App->entityManager->units.speed[simIndex] = amount;
 }
 
-void Unit::SetDestination()
+// Replaces the current path, the first waypoint is where the unit heads to right away
+void Unit::FollowPath(const vector<iPoint>& waypoints)
 {
-	iPoint target;
-	App->input->GetMousePosition(target.x, target.y);
-	target = App->map->WorldToMap(target.x - App->render->camera.x, target.y - App->render->camera.y);
+	path.clear();
+	attackUnitTarget = EntityHandle();
 
-	iPoint origin = App->map->WorldToMap(entityPosition.x, entityPosition.y);
+	if (waypoints.empty())
+		return;
 
-	if (App->pathfinding->CreatePath(origin, target)) {
-		const p2DynArray<iPoint>* last_path = App->pathfinding->GetLastPath();
-		int elem_num = last_path->Count();
-		for (int i = 0; i < elem_num; i++)
-			path.push_back(*(last_path->At(i)));
-	}
+	for (uint i = 1; i < waypoints.size(); i++)
+		path.push_back(waypoints[i]);
+
+	SetState(UNIT_MOVING);
+	SetWaypoint(waypoints.front());
+}
+
+// Steers towards tile before resuming the current waypoint
+void Unit::Detour(const iPoint& tile)
+{
+	if (tile == destinationTile)
+		return;
+
+	path.push_front(destinationTile);
+	SetWaypoint(tile);
+}
 
+void Unit::SetWaypoint(const iPoint& tile)
+{
+	destinationTile = tile;
+	iPoint world = App->map->MapToWorld(tile.x + 1, tile.y);
+	App->entityManager->units.waypoint[simIndex] = simPoint(world.x, world.y);
+	ClearPredictions();
+}
+
+void Unit::OnWaypointReached()
+{
 	if (path.size() > 0) {
-		SetState(UNIT_MOVING);
-		if (path.front() == origin) {
-			if (path.size() > 1) {
-				destinationTile = path.begin()._Ptr->_Next->_Myval;
-				path.remove(path.begin()._Ptr->_Next->_Myval);
-			}
-		}
-		else {
-			destinationTile = path.front();
-		}
-		path.erase(path.begin());
+		SetWaypoint(path.front());
+		path.pop_front();
 	}
+	else
+		SetState(UNIT_IDLE);
 }
 
-void Unit::Move(float dt)
+void Unit::ClearPredictions()
 {
+	App->entityManager->units.predictions[simIndex].Clear();
+}
 
-	CalculateVelocity();
-	LookAt();
+Pred_Pos Unit::PredictStep(const Pred_Pos& from, const simPoint& target, simScalar speed, simScalar step)
+{
+	// once the waypoint is reached we stay there until the unit picks the next one
+	if (from.pos.DistanceNoSqrt(target) < 4)
+		return from;
 
-	fPoint vel = (velocity * (unitMovementSpeed * 1.5));
-	roundf(vel.x);
-	roundf(vel.y);
+	simPoint vel(target.x - from.pos.x, target.y - from.pos.y);
+	simScalar distance = vel.DistanceTo(simPoint(0, 0));
+	vel.Normalize();
 
+	// don't overshoot the waypoint on the last step
+	simScalar travel = MIN(speed * simScalar(UNIT_SPEED_SCALE) * step, distance);
 
-	entityPosition.x += int(vel.x);
-	entityPosition.y += int(vel.y);
+	return Pred_Pos(from.pos + vel * travel, GetDirection(vel), vel);
+}
 
-	if (entityPosition.DistanceNoSqrt(destinationTileWorld) < 4) {
+const Pred_Pos* Unit::GetLastPrediction() const
+{
+	return App->entityManager->units.predictions[simIndex].Back();
+}
 
-		if (path.size() > 0) {
-			destinationTile = path.front();
-			path.pop_front();
-		}
-		else
-			SetState(UNIT_IDLE);
-	}
+const AnimationPlayhead& Unit::GetAnim() const
+{
+	return App->entityManager->units.anim[simIndex];
+}
+
+const Animation& Unit::GetCurrentClip() const
+{
+	return archetype->clips[GetAnim().clip];
 }
 
-void Unit::CalculateVelocity()
+// tan(22.5), an axis only counts once the other one is under this slope of it
+#define DIRECTION_SLOPE 0.41421356f
+
+// indexed by (sign y + 1) * 3 + (sign x + 1), standing still faces DOWN_LEFT
+static const unitDirection directionTable[9] = {
+	UP_LEFT, UP, UP_RIGHT,
+	LEFT, DOWN_LEFT, RIGHT,
+	DOWN_LEFT, DOWN, DOWN_RIGHT
+};
+
+// Picks the octant with sign and slope comparisons only, no atan2
+static inline int DirectionIndex(simScalar x, simScalar y)
 {
-	destinationTileWorld = App->map->MapToWorld(destinationTile.x + 1, destinationTile.y);
+	simScalar ax = Abs(x);
+	simScalar ay = Abs(y);
+	simScalar slope(DIRECTION_SLOPE);
 
-	velocity.x = destinationTileWorld.x - entityPosition.x;
-	velocity.y = destinationTileWorld.y - entityPosition.y;
+	int sx = int(x > slope * ay) - int(x < -(slope * ay));
+	int sy = int(y > slope * ax) - int(y < -(slope * ax));
 
-	if(velocity.x != 0 || velocity.y != 0)
-		velocity.Normalize();
+	return (sy + 1) * 3 + (sx + 1);
 }
 
+unitDirection Unit::GetDirection(const simPoint& vel)
+{
+	return directionTable[DirectionIndex(vel.x, vel.y)];
+}
 
-void Unit::LookAt()
+void Unit::GetDirections(const simPoint* vel, unitDirection* directions, uint count)
 {
-	if(velocity.x == 0 && velocity.y == 0)
-		direction = DOWN_LEFT;
-	else {
+	for (uint i = 0; i < count; i++)
+		directions[i] = directionTable[DirectionIndex(vel[i].x, vel[i].y)];
+}
 
-		float angle = atan2f(velocity.y, velocity.x) * RADTODEG;
 
-		if (angle < 22.5 && angle > -22.5)
-			direction = RIGHT;
-		else if (angle >= 22.5 && angle <= 67.5)
-			direction = DOWN_RIGHT;
-		else if (angle > 67.5 && angle < 112.5)
-			direction = DOWN;
-		else if (angle >= 112.5 && angle <= 157.5)
-			direction = DOWN_LEFT;
-		else if (angle > 157.5 || angle < -157.5)
-			direction = LEFT;
-		else if (angle >= -157.5 && angle <= -112.5)
-			direction = UP_LEFT;
-		else if (angle > -112.5 && angle < -67.5)
-			direction = UP;
-		else if (angle >= -67.5 && angle <= -22.5)
-			direction = UP_RIGHT;
+// Heads straight for tile, keeping the current target
+void Unit::Chase(const iPoint& tile)
+{
+	path.clear();
+	if (GetState() != UNIT_MOVING)
+		SetState(UNIT_MOVING);
+	SetWaypoint(tile);
+}
+
+bool Unit::Attack(simScalar step)
+{
+	timer += step;
+	if (timer < attackSpeed)
+		return false;
 
-	}
+	timer -= attackSpeed;
+	return true;
+}
 
-	if (direction != currentDirection)
-	{
-		currentDirection = direction;
-		SetAnim(currentDirection);
-	}
+bool Unit::Decay(simScalar step)
+{
+	const Animation& clip = GetCurrentClip();
+	if (clip.speed <= 0.0f)
+		return true;
 
+	timer += step;
+	return timer >= simScalar(clip.Count() / (clip.speed * DEATH_CLIP_FPS));
 }
 
+// Defense soaks the normal damage, piercing damage always goes through
+int Unit::GetDamageAgainst(const Unit* target) const
+{
+	return MAX(1, unitAttack - target->unitDefense) + unitPiercingDamage;
+}
 
 void Unit::Dead() {
 	SetState(UNIT_DEAD);
@@ -346,28 +295,32 @@ void Unit::Dead() {
 
 void Unit::SetState(unitState newState)
 {
+	UnitArrays& units = App->entityManager->units;
+
+	if (newState != units.state[simIndex])
+		units.anim[simIndex].Reset();
+
+	units.state[simIndex] = newState;
+
 	switch (newState) {
 	case UNIT_IDLE:
-		this->state = UNIT_IDLE;
-		SetAnim(currentDirection);
+		ClearPredictions();
 		entityTexture = unitIdleTexture;
 		break;
 	case UNIT_MOVING:
-		this->state = UNIT_MOVING;
-		SetAnim(currentDirection);
 		entityTexture = unitMoveTexture;
 		break;
 	case UNIT_ATTACKING:
-		this->state = UNIT_ATTACKING;
-		SetAnim(currentDirection);
+		timer = 0;
 		entityTexture = unitAttackTexture;
 		break;
 	case UNIT_DEAD:
-		this->state = UNIT_DEAD;
-		SetAnim(currentDirection);
+		timer = 0;
 		entityTexture = unitDieTexture;
 		break;
 	}
+
+	SetAnim(units.direction[simIndex]);
 }
 
 bool Unit::Load(pugi::xml_node & node)
@@ -380,22 +333,55 @@ bool Unit::Save(pugi::xml_node & node) const
 	return true;
 }
 
+bool Unit::LoadSnapshot(SnapshotReader& data)
+{
+	Entity::LoadSnapshot(data);
+	data.Read(unitLife);
+	data.Read(timer);
+	data.Read(destinationTile);
+	data.Read(attackUnitTarget);
+	data.Read(isSelected);
+	data.Read(isVisible);
+
+	uint waypoints = 0;
+	data.Read(waypoints);
+	path.clear();
+	for (uint i = 0; i < waypoints && data.Failed() == false; i++) {
+		iPoint tile;
+		data.Read(tile);
+		path.push_back(tile);
+	}
+
+	entityTexture = archetype->textures[GetState()];
+	return data.Failed() == false;
+}
+
+bool Unit::SaveSnapshot(SnapshotWriter& data) const
+{
+	Entity::SaveSnapshot(data);
+	data.Write(unitLife);
+	data.Write(timer);
+	data.Write(destinationTile);
+	data.Write(attackUnitTarget);
+	data.Write(isSelected);
+	data.Write(isVisible);
+
+	data.Write(path.size());
+	for (uint i = 0; i < path.size(); i++)
+		data.Write(path[i]);
+
+	return true;
+}
+
+bool Unit::IsEnemy() const
+{
+	return isEnemy;
+}
+
 void Unit::SetAnim(unitDirection currentDirection) {
 
-	switch (state) {
-	case UNIT_IDLE:
-		currentAnim = &idleAnimations[currentDirection];
-		break;
-	case UNIT_MOVING:
-		currentAnim = &movingAnimations[currentDirection];
-		break;
-	case UNIT_ATTACKING:
-		currentAnim = &attackingAnimations[currentDirection];
-		break;
-	case UNIT_DEAD:
-		currentAnim = &dyingAnimations[currentDirection];
-		break;
-	}
+	UnitArrays& units = App->entityManager->units;
+	units.anim[simIndex].Play(archetype->firstClip[units.state[simIndex]] + currentDirection);
 }
 
 pugi::xml_node Unit::LoadUnitInfo(unitType type)
@@ -2,14 +2,26 @@
 #define __UNIT_H__
 
 #define MAX_PRED_POS 5
+#define MAX_UNIT_ANIMATIONS 4
+// pixels per second for each point of MovementSpeed, the old 1.5 pixels per frame at 60 fps
+#define UNIT_SPEED_SCALE 90.0f
+// Deterministic builds remove corpses on the simulation clock, after the death clip would have
+// played at this frame rate
+#define DEATH_CLIP_FPS 60
+// Collider radii in pixels, avoidance uses the hard one as the unit's size
+#define UNIT_SOFT_RADIUS 15
+#define UNIT_HARD_RADIUS 8
 
 #include "p2Point.h"
+#include "p2Fixed.h"
 #include "Entity.h"
 #include "Animation.h"
+#include "WaypointQueue.h"
 #include <list>
 #include <vector>
 #include "j1Input.h"
 #include "j1Map.h"
+#include <string>
 
 class Building;
 
@@ -29,73 +41,175 @@ enum unitFaction {
 	FREE_MEN_UNIT, SAURON_ARMY_UNIT
 };
 
+// Full rate units are simulated every tick, reduced ones every LOD_REDUCED_INTERVAL ticks
+enum unitLOD {
+	LOD_FULL, LOD_REDUCED
+};
+
 enum unitDirection {
 	DOWN, DOWN_LEFT, DOWN_RIGHT, LEFT, RIGHT, UP_LEFT, UP_RIGHT, UP
 };
 
 
+// Sprite sheet layout of one animation, one row per direction
+struct AnimationLayout
+{
+	int width = 0;
+	int height = 0;
+	int rows = 0;
+	int columns = 0;
+	float speed = 0.0f;
+};
+
+// Everything units of the same type share, parsed once from GameData.xml
+// animations and textures are indexed by unitState
+struct UnitArchetype
+{
+	bool loaded = false;
+	unitType type;
+	unitFaction faction;
+	int life = 0;
+	int attack = 0;
+	float attackSpeed = 0.0f;
+	int defense = 0;
+	int piercingDamage = 0;
+	float movementSpeed = 0.0f;
+	int lineOfSight = 0;
+
+	AnimationLayout animations[MAX_UNIT_ANIMATIONS];
+	std::string texturePaths[MAX_UNIT_ANIMATIONS];
+
+	// every direction of every animation, a unit plays clips[firstClip[state] + direction]
+	vector<Animation> clips;
+	uint firstClip[MAX_UNIT_ANIMATIONS] = { 0, 0, 0, 0 };
+	SDL_Texture* textures[MAX_UNIT_ANIMATIONS] = { nullptr, nullptr, nullptr, nullptr };
+};
+
 class Pred_Pos {
 
 public:
-	iPoint pos;
+	simPoint pos;
 	unitDirection dir;
-	fPoint vel;
+	simPoint vel;
 
-	Pred_Pos(iPoint position, unitDirection direction, fPoint velocity) : pos(position), dir(direction), vel(velocity)
+	Pred_Pos()
 	{}
 
+	Pred_Pos(simPoint position, unitDirection direction, simPoint velocity) : pos(position), dir(direction), vel(velocity)
+	{}
+
+};
+
+// Rolling queue of predicted positions, front is the next step
+struct PredictionQueue
+{
+	Pred_Pos steps[MAX_PRED_POS];
+	uint front = 0;
+	uint count = 0;
+
+	bool Empty() const
+	{
+		return count == 0;
+	}
+
+	void Clear()
+	{
+		front = count = 0;
+	}
+
+	Pred_Pos PopFront()
+	{
+		Pred_Pos ret = steps[front];
+		front = (front + 1) % MAX_PRED_POS;
+		count--;
+		return ret;
+	}
+
+	void PushBack(const Pred_Pos& step)
+	{
+		steps[(front + count) % MAX_PRED_POS] = step;
+		count++;
+	}
+
+	const Pred_Pos* Back() const
+	{
+		return (count == 0) ? nullptr : &steps[(front + count - 1) % MAX_PRED_POS];
+	}
 };
 
+// Cold data of a unit, the simulated state (position, velocity, state, waypoint, speed,
+// direction, animation and predictions) lives in EntityManager's unit arrays at simIndex
 class Unit : public Entity
 {
 public:
-	Unit(int posX, int posY, bool isEnemy, unitType type);
+	Unit();
 	~Unit();
 
-	bool Update(float dt);
+	// Units are pooled: Spawn sets one up as a new unit of archetype, Recycle puts it back
+	void Spawn(int posX, int posY, bool isEnemy, const UnitArchetype* archetype);
+	void Recycle();
+
 	bool Draw();
+	void UpdateColliders();
 
 	unitType GetType()const;
 	int GetLife() const;
+	unitState GetState() const;
 	void SetPos(int posX, int posY);
 	void SetSpeed(int amount);
-	void SetDestination();
-	void Move(float dt);
-	void CalculateVelocity();
-	void LookAt();
+	void FollowPath(const vector<iPoint>& waypoints);
+	void SetWaypoint(const iPoint& tile);
+	void OnWaypointReached();
+	void Detour(const iPoint& tile);
+	static unitDirection GetDirection(const simPoint& vel);
+	// GetDirection over a whole array of velocities
+	static void GetDirections(const simPoint* vel, unitDirection* directions, uint count);
 	void SetAnim(unitDirection currentDirection);
+	void Chase(const iPoint& tile);
+	// advances the attack cooldown, true when a hit lands
+	bool Attack(simScalar step);
+	// advances the corpse timer, true once the death clip has played out
+	bool Decay(simScalar step);
+	int GetDamageAgainst(const Unit* target) const;
 	void Dead();
 	void SetState(unitState state);
 	pugi::xml_node LoadUnitInfo(unitType type);
 
+	// Predicted positions, one per simulation tick of step seconds
+	static Pred_Pos PredictStep(const Pred_Pos& from, const simPoint& target, simScalar speed, simScalar step);
+	void ClearPredictions();
+	const Pred_Pos* GetLastPrediction() const;
+	const AnimationPlayhead& GetAnim() const;
+	const Animation& GetCurrentClip() const;
+
 
 	bool Load(pugi::xml_node&);
 	bool Save(pugi::xml_node&) const;
-	unitState state;
-	list<iPoint> path;
+	// the simulated state is saved with the unit arrays, this is the rest
+	bool LoadSnapshot(SnapshotReader&);
+	bool SaveSnapshot(SnapshotWriter&) const;
+	bool IsEnemy() const;
+	WaypointQueue path;
+	uint simIndex;
 
 private:
+	const UnitArchetype* archetype;
 	unitType type;
 	unitFaction faction;
-	unitDirection direction;
 	float unitAttackSpeed;
 	int unitPiercingDamage;
-	float unitMovementSpeed;
 	bool isEnemy;
-	fPoint velocity;
 	iPoint destinationTile;
-	iPoint destinationTileWorld;
-	float attackSpeed;
-	float timer = 0;
+	simScalar attackSpeed;
+	simScalar timer = simScalar(0);
 	int hpBarWidth;
-	unitDirection currentDirection;
 	SDL_Texture* unitIdleTexture;
 	SDL_Texture* unitMoveTexture;
 	SDL_Texture* unitAttackTexture;
 	SDL_Texture* unitDieTexture;
 
 public:
-	Unit* attackUnitTarget;
+	EntityHandle attackUnitTarget;
 	Building* attackBuildingTarget;
 	int unitLife;
 	int unitMaxLife;
@@ -104,14 +218,6 @@ public:
 	bool isVisible;
 	bool isSelected;
 
-	//Animations
-	vector<Animation> idleAnimations;
-	vector<Animation> movingAnimations;
-	vector<Animation> attackingAnimations;
-	vector<Animation> dyingAnimations;
-
-	Animation* currentAnim = nullptr;
-
 };
 
 
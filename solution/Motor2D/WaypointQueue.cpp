@@ -0,0 +1,74 @@
+#include "WaypointQueue.h"
+#include <vector>
+
+// Spilled blocks by size class, class n holds WAYPOINT_INLINE_CAPACITY << (n + 1) tiles,
+// the last class takes anything bigger and is never pooled
+#define WAYPOINT_POOL_CLASSES 12
+
+static std::vector<iPoint*> free_blocks[WAYPOINT_POOL_CLASSES];
+
+static uint SizeClass(uint capacity)
+{
+	uint size_class = 0;
+	while (size_class < WAYPOINT_POOL_CLASSES - 1 && (WAYPOINT_INLINE_CAPACITY << (size_class + 1)) < capacity)
+		size_class++;
+
+	return size_class;
+}
+
+static iPoint* AcquireBlock(uint capacity)
+{
+	std::vector<iPoint*>& blocks = free_blocks[SizeClass(capacity)];
+
+	if (blocks.empty())
+		return new iPoint[capacity];
+
+	iPoint* block = blocks.back();
+	blocks.pop_back();
+	return block;
+}
+
+static void ReleaseBlock(iPoint* block, uint capacity)
+{
+	uint size_class = SizeClass(capacity);
+
+	// the biggest class isn't worth keeping around
+	if (size_class == WAYPOINT_POOL_CLASSES - 1)
+		delete[] block;
+	else
+		free_blocks[size_class].push_back(block);
+}
+
+void WaypointQueue::Grow()
+{
+	uint new_capacity = capacity * 2;
+	iPoint* block = AcquireBlock(new_capacity);
+
+	// unwrap the ring so head starts at 0
+	for (uint i = 0; i < count; i++)
+		block[i] = data[(head + i) & (capacity - 1)];
+
+	Release();
+
+	data = block;
+	capacity = new_capacity;
+	head = 0;
+}
+
+void WaypointQueue::Release()
+{
+	if (data != storage) {
+		ReleaseBlock(data, capacity);
+		data = storage;
+		capacity = WAYPOINT_INLINE_CAPACITY;
+	}
+}
+
+void WaypointQueue::ReleasePool()
+{
+	for (uint i = 0; i < WAYPOINT_POOL_CLASSES; i++) {
+		for (uint j = 0; j < free_blocks[i].size(); j++)
+			delete[] free_blocks[i][j];
+		free_blocks[i].clear();
+	}
+}
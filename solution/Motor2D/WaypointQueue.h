@@ -0,0 +1,106 @@
+#ifndef __WAYPOINTQUEUE_H__
+#define __WAYPOINTQUEUE_H__
+
+#include "p2Point.h"
+#include "p2Defs.h"
+
+// Waypoints stored inside the unit, longer paths spill to a block from the shared pool
+#define WAYPOINT_INLINE_CAPACITY 16
+
+// Ring buffer of tiles with O(1) push and pop at both ends. Capacity is always a power of two.
+// Pool blocks are handed out and returned from the main thread only.
+// Like the std containers, front, back and [] expect the queue to hold that tile.
+class WaypointQueue
+{
+public:
+
+	WaypointQueue() : data(storage), capacity(WAYPOINT_INLINE_CAPACITY), head(0), count(0)
+	{}
+
+	~WaypointQueue()
+	{
+		Release();
+	}
+
+	bool empty() const
+	{
+		return count == 0;
+	}
+
+	uint size() const
+	{
+		return count;
+	}
+
+	const iPoint& front() const
+	{
+		return data[head];
+	}
+
+	const iPoint& back() const
+	{
+		return data[(head + count - 1) & (capacity - 1)];
+	}
+
+	const iPoint& operator[](uint index) const
+	{
+		return data[(head + index) & (capacity - 1)];
+	}
+
+	void push_back(const iPoint& tile)
+	{
+		if (count == capacity)
+			Grow();
+
+		data[(head + count) & (capacity - 1)] = tile;
+		count++;
+	}
+
+	void push_front(const iPoint& tile)
+	{
+		if (count == capacity)
+			Grow();
+
+		head = (head - 1) & (capacity - 1);
+		data[head] = tile;
+		count++;
+	}
+
+	void pop_front()
+	{
+		if (count == 0)
+			return;
+
+		head = (head + 1) & (capacity - 1);
+		count--;
+	}
+
+	// frees the blocks the pool holds, queues still using one keep it
+	static void ReleasePool();
+
+	// hands a spilled block back to the pool
+	void clear()
+	{
+		Release();
+		head = count = 0;
+	}
+
+private:
+
+	// not copyable, data may point to our own storage
+	WaypointQueue(const WaypointQueue&);
+	WaypointQueue& operator =(const WaypointQueue&);
+
+	void Grow();
+	void Release();
+
+private:
+
+	iPoint	storage[WAYPOINT_INLINE_CAPACITY];
+	iPoint*	data;
+	uint	capacity;
+	uint	head;
+	uint	count;
+};
+
+#endif // __WAYPOINTQUEUE_H__
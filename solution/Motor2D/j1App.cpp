@@ -1,8 +1,11 @@
 #include <iostream> 
 #include <sstream> 
+#include <algorithm>
+#include <string.h>
 
 #include "p2Defs.h"
 #include "p2Log.h"
+#include "p2Fixed.h"
 
 #include "j1Window.h"
 #include "j1Input.h"
@@ -13,6 +16,7 @@
 #include "j1Map.h"
 #include "j1Collision.h"
 #include "EntityManager.h"
+#include "j1FogOfWar.h"
 #include "j1Pathfinding.h"
 #include "j1Gui.h"
 #include "j1App.h"
@@ -33,6 +37,7 @@ j1App::j1App(int argc, char* args[]) : argc(argc), args(args)
 	entityManager = new EntityManager();
 	collision = new j1Collision();
 	gui = new j1Gui();
+	fog = new j1FogOfWar();
 
 	// Ordered for awake / Start / Update
 	// Reverse order of CleanUp
@@ -42,6 +47,7 @@ j1App::j1App(int argc, char* args[]) : argc(argc), args(args)
 	AddModule(tex);
 	AddModule(map);
 	AddModule(pathfinding);
+	AddModule(fog);
 	AddModule(gui);
 
 
@@ -87,7 +93,9 @@ bool j1App::Awake()
 	pugi::xml_node		app_config;
 
 	bool ret = false;
-		
+
+	ParseArguments();
+
 	config = LoadConfig(config_file);
 
 	if(config.empty() == false)
@@ -104,6 +112,16 @@ bool j1App::Awake()
 		{
 			capped_ms = 1000 / cap;
 		}
+
+		int sim_rate = app_config.attribute("sim_rate").as_int(20);
+
+		if(sim_rate > 0)
+		{
+			fixed_step = 1.0f / sim_rate;
+		}
+
+		workers.Init(app_config.attribute("workers").as_uint(0));
+		autosave_interval = app_config.attribute("autosave").as_float(0.0f);
 	}
 
 	if(ret == true)
@@ -137,6 +155,7 @@ bool j1App::Start()
 		item = item->next;
 	}
 	startup_time.Start();
+	autosave_time.Start();
 
 	PERF_PEEK(ptimer);
 
@@ -152,9 +171,15 @@ bool j1App::Update()
 	if(input->GetWindowEvent(WE_QUIT) == true)
 		ret = false;
 
+	if(replaying == true && entityManager->ReplayFinished() == true)
+		ret = false;
+
 	if(ret == true)
 		ret = PreUpdate();
 
+	if(ret == true)
+		ret = DoFixedUpdate();
+
 	if(ret == true)
 		ret = DoUpdate();
 
@@ -208,17 +233,41 @@ void j1App::PrepareUpdate()
 
 	dt = frame_time.ReadSec();
 	frame_time.Start();
+
+	// replays run exactly one tick per frame, however long the frame takes
+	if(replaying == true)
+	{
+		dt = fixed_step;
+		replay_frame_timer.Start();
+	}
+
+	accumulator += dt;
 }
 
 // ---------------------------------------------
 void j1App::FinishUpdate()
 {
+	if(replaying == true)
+		replay_frame_ms.push_back(replay_frame_timer.ReadMs());
+
 	if(want_to_save == true)
 		SavegameNow();
 
 	if(want_to_load == true)
 		LoadGameNow();
 
+	if(autosave_interval > 0.0f && replaying == false && autosave_time.ReadSec() >= autosave_interval)
+	{
+		autosave_time.Start();
+		SaveSnapshot(AUTOSAVE_FILE);
+	}
+
+	if(want_to_save_snapshot == true)
+		SaveSnapshotNow();
+
+	if(want_to_load_snapshot == true)
+		LoadSnapshotNow();
+
 	// Framerate calculations --
 
 	if(last_sec_frame_time.Read() > 1000)
@@ -238,7 +287,7 @@ void j1App::FinishUpdate()
 			  avg_fps, last_frame_ms, frames_on_last_update, dt, seconds_since_startup, frame_count);
 	App->win->SetTitle(title);
 
-	if(capped_ms > 0 && last_frame_ms < capped_ms)
+	if(capped_ms > 0 && last_frame_ms < capped_ms && replaying == false)
 	{
 		j1PerfTimer t;
 		SDL_Delay(capped_ms - last_frame_ms);
@@ -269,6 +318,39 @@ bool j1App::PreUpdate()
 }
 
 // Call modules on each loop iteration
+bool j1App::DoFixedUpdate()
+{
+	bool ret = true;
+	uint steps = 0;
+
+	while(accumulator >= fixed_step && ret == true)
+	{
+		if(steps++ == MAX_FIXED_STEPS_PER_FRAME)
+		{
+			LOG("Simulation is falling behind, dropping %.3f seconds", accumulator);
+			accumulator = 0.0f;
+			break;
+		}
+
+		for(p2List_item<j1Module*>* item = modules.start; item != NULL && ret == true; item = item->next)
+		{
+			if(item->data->active == false) {
+				continue;
+			}
+
+			ret = item->data->FixedUpdate(fixed_step);
+		}
+
+		accumulator -= fixed_step;
+	}
+
+	// how far we are between the last two simulated states
+	alpha = accumulator / fixed_step;
+
+	return ret;
+}
+
+// ---------------------------------------------
 bool j1App::DoUpdate()
 {
 	bool ret = true;
@@ -325,6 +407,12 @@ bool j1App::CleanUp()
 		item = item->prev;
 	}
 
+	workers.CleanUp();
+	WaitForSnapshotWrite();
+
+	if(replaying == true)
+		SaveReplayTimings();
+
 	PERF_PEEK(ptimer);
 	return ret;
 }
@@ -356,6 +444,81 @@ float j1App::GetDT() const
 	return dt;
 }
 
+// ---------------------------------------
+float j1App::GetFixedStep() const
+{
+	return fixed_step;
+}
+
+// ---------------------------------------
+float j1App::GetInterpolationAlpha() const
+{
+	return alpha;
+}
+
+// ---------------------------------------
+bool j1App::IsReplaying() const
+{
+	return replaying;
+}
+
+// ---------------------------------------
+bool j1App::IsHeadless() const
+{
+	return headless;
+}
+
+// ---------------------------------------
+const char* j1App::GetReplayFile() const
+{
+	return replay_file.GetString();
+}
+
+// ---------------------------------------
+void j1App::ParseArguments()
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		if(strcmp(args[i], "-replay") == 0 && i + 1 < argc)
+		{
+			// logs are recorded to the write directory
+			replaying = true;
+			replay_file.create("%s%s", fs->GetSaveDirectory(), args[++i]);
+		}
+		else if(strcmp(args[i], "-headless") == 0)
+			headless = true;
+	}
+
+	// nothing to drive a headless game but a replay
+	if(replaying == false)
+		headless = false;
+}
+
+// One line per frame with its time in ms, then a summary in the log
+void j1App::SaveReplayTimings() const
+{
+	if(replay_frame_ms.empty() == true)
+		return;
+
+	std::stringstream stream;
+	stream << "frame,ms\n";
+
+	double total = 0.0;
+	for(uint i = 0; i < replay_frame_ms.size(); ++i)
+	{
+		stream << i << "," << replay_frame_ms[i] << "\n";
+		total += replay_frame_ms[i];
+	}
+
+	fs->Save("replay_timings.csv", stream.str().c_str(), stream.str().length());
+
+	std::vector<double> sorted(replay_frame_ms);
+	std::sort(sorted.begin(), sorted.end());
+
+	LOG("Replay of %s: %u frames, average %.3f ms, 99th percentile %.3f ms, worst %.3f ms",
+		replay_file.GetString(), (uint)sorted.size(), total / sorted.size(), sorted[(sorted.size() * 99) / 100], sorted.back());
+}
+
 // ---------------------------------------
 const char* j1App::GetOrganization() const
 {
@@ -459,7 +622,8 @@ bool j1App::SavegameNow() const
 		data.save(stream);
 
 		// we are done, so write data to disk
-		fs->Save(save_game.GetString(), stream.str().c_str(), stream.str().length());
+		const std::string& text = stream.str();
+		fs->Save(save_game.GetString(), text.c_str(), text.length());
 		LOG("... finished saving", save_game.GetString());
 	}
 	else
@@ -468,4 +632,155 @@ bool j1App::SavegameNow() const
 	data.reset();
 	want_to_save = false;
 	return ret;
-}
\ No newline at end of file
+}
+
+// ---------------------------------------
+void j1App::LoadSnapshot(const char* file)
+{
+	// the replay is driving the match from its log
+	if(replaying == true)
+	{
+		LOG("Snapshots can't be loaded during a replay");
+		return;
+	}
+
+	want_to_load_snapshot = true;
+	load_snapshot.create("%s%s", fs->GetSaveDirectory(), file);
+}
+
+// ---------------------------------------
+void j1App::SaveSnapshot(const char* file)
+{
+	want_to_save_snapshot = true;
+	save_snapshot.create("%s", file);
+}
+
+// ---------------------------------------
+void j1App::WaitForSnapshotWrite()
+{
+	if(snapshot_thread.joinable() == true)
+		snapshot_thread.join();
+}
+
+// ---------------------------------------
+j1Module* j1App::FindModule(const char* name) const
+{
+	for(p2List_item<j1Module*>* item = modules.start; item != NULL; item = item->next)
+	{
+		if(item->data->name == name)
+			return item->data;
+	}
+
+	return NULL;
+}
+
+// Header, then one chunk per module: name length, name, payload size and payload
+bool j1App::SaveSnapshotNow()
+{
+	want_to_save_snapshot = false;
+	j1PerfTimer timer;
+
+	// the buffer is still being written out by the last save
+	WaitForSnapshotWrite();
+
+	snapshot.Clear();
+	snapshot.Write((uint32)SNAPSHOT_MAGIC);
+	snapshot.Write((uint32)SNAPSHOT_VERSION);
+	snapshot.Write((uint32)sizeof(simScalar));
+
+	for(p2List_item<j1Module*>* item = modules.start; item != NULL; item = item->next)
+	{
+		uchar name_length = (uchar)item->data->name.Length();
+		snapshot.Write(name_length);
+		snapshot.WriteBytes(item->data->name.GetString(), name_length);
+
+		uint size_offset = snapshot.Size();
+		snapshot.Write((uint32)0);
+
+		if(item->data->SaveSnapshot(snapshot) == false)
+		{
+			LOG("Snapshot halted from an error in module %s", item->data->name.GetString());
+			return false;
+		}
+
+		snapshot.Patch(size_offset, (uint32)(snapshot.Size() - size_offset - sizeof(uint32)));
+	}
+
+	p2SString file(save_snapshot);
+	snapshot_thread = std::thread([this, file]() {
+		if(fs->Save(file.GetString(), snapshot.Data(), snapshot.Size()) == 0)
+			LOG("Could not write snapshot %s", file.GetString());
+	});
+
+	LOG("Snapshot of %u bytes taken in %.3f ms, writing it to %s", snapshot.Size(), timer.ReadMs(), save_snapshot.GetString());
+	return true;
+}
+
+bool j1App::LoadSnapshotNow()
+{
+	want_to_load_snapshot = false;
+	j1PerfTimer timer;
+
+	// the file may be the one still being written
+	WaitForSnapshotWrite();
+
+	char* buffer = NULL;
+	uint size = fs->Load(load_snapshot.GetString(), &buffer);
+
+	if(size == 0)
+	{
+		LOG("Could not load snapshot %s", load_snapshot.GetString());
+		return false;
+	}
+
+	SnapshotReader reader(buffer, size);
+	uint32 magic = 0, version = 0, scalar_size = 0;
+	reader.Read(magic);
+	reader.Read(version);
+	reader.Read(scalar_size);
+
+	if(reader.Failed() == true || magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION || scalar_size != sizeof(simScalar))
+	{
+		LOG("%s is not a snapshot this build can load", load_snapshot.GetString());
+		RELEASE_ARRAY(buffer);
+		return false;
+	}
+
+	bool ret = true;
+
+	// chunks of modules this build doesn't have are skipped
+	while(ret == true && reader.Remaining() > 0)
+	{
+		uchar name_length = 0;
+		char name[256];
+		uint32 chunk_size = 0;
+
+		reader.Read(name_length);
+		reader.ReadBytes(name, name_length);
+		reader.Read(chunk_size);
+		name[name_length] = '\0';
+
+		SnapshotReader chunk = reader.Split(chunk_size);
+		if(reader.Failed() == true)
+		{
+			LOG("Snapshot %s is truncated, the game state is only partly loaded", load_snapshot.GetString());
+			ret = false;
+			break;
+		}
+
+		j1Module* module = FindModule(name);
+		if(module != NULL && (module->LoadSnapshot(chunk) == false || chunk.Failed() == true))
+		{
+			// modules check their chunk before changing anything, but the ones before this have loaded
+			LOG("Snapshot loading interrupted with error on module %s, the game state is only partly loaded", name);
+			ret = false;
+		}
+	}
+
+	RELEASE_ARRAY(buffer);
+
+	if(ret == true)
+		LOG("Loaded snapshot %s in %.3f ms", load_snapshot.GetString(), timer.ReadMs());
+
+	return ret;
+}
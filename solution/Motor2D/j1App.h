@@ -5,7 +5,20 @@
 #include "j1Module.h"
 #include "j1PerfTimer.h"
 #include "j1Timer.h"
+#include "j1ThreadPool.h"
+#include "p2Snapshot.h"
 #include "PugiXml\src\pugixml.hpp"
+#include <vector>
+#include <thread>
+
+// Simulation ticks allowed per frame before the accumulator drops time, so a slow frame
+// can't snowball into ever longer ones
+#define MAX_FIXED_STEPS_PER_FRAME 5
+
+// Snapshots are only read back by a build with the same version and simulation scalar
+#define SNAPSHOT_MAGIC 0x50414E53 // "SNAP"
+#define SNAPSHOT_VERSION 4
+#define AUTOSAVE_FILE "autosave.snap"
 
 // Modules
 class j1Window;
@@ -21,6 +34,7 @@ class j1Fonts;
 class j1Gui;
 class j1Collision;
 class EntityManager;
+class j1FogOfWar;
 
 class j1App
 {
@@ -53,12 +67,25 @@ public:
 	const char* GetTitle() const;
 	const char* GetOrganization() const;
 	float GetDT() const;
+	float GetFixedStep() const;
+	float GetInterpolationAlpha() const;
+
+	// Replays feed a recorded command log to the simulation instead of reading input,
+	// one tick per frame as fast as possible. Headless ones don't draw either.
+	bool IsReplaying() const;
+	bool IsHeadless() const;
+	const char* GetReplayFile() const;
 
 	void LoadGame(const char* file);
 	void SaveGame(const char* file) const;
 	void GetSaveGames(p2List<p2SString>& list_to_fill) const;
 	pugi::xml_node LoadGameData(pugi::xml_document&) const;
 
+	// Binary quick saves: every module writes a chunk to one buffer, which goes to disk
+	// on its own thread so saving fits in a frame
+	void LoadSnapshot(const char* file);
+	void SaveSnapshot(const char* file);
+
 private:
 
 	// Load config file
@@ -74,6 +101,9 @@ private:
 	// Call modules before each loop iteration
 	bool PreUpdate();
 
+	// Call modules once per elapsed simulation tick
+	bool DoFixedUpdate();
+
 	// Call modules on each loop iteration
 	bool DoUpdate();
 
@@ -83,6 +113,14 @@ private:
 	// Load / Save
 	bool LoadGameNow();
 	bool SavegameNow() const;
+	bool LoadSnapshotNow();
+	bool SaveSnapshotNow();
+	void WaitForSnapshotWrite();
+	j1Module* FindModule(const char* name) const;
+
+	// Reads -replay <file> and -headless
+	void ParseArguments();
+	void SaveReplayTimings() const;
 
 public:
 
@@ -98,6 +136,10 @@ public:
 	j1Gui*				gui = NULL;
 	j1Collision*		collision = NULL;
 	EntityManager*		entityManager = NULL;
+	j1FogOfWar*			fog = NULL;
+
+	// Worker threads shared by all modules
+	j1ThreadPool		workers;
 
 private:
 
@@ -113,6 +155,17 @@ private:
 	p2SString			load_game;
 	mutable p2SString	save_game;
 
+	bool				want_to_save_snapshot = false;
+	bool				want_to_load_snapshot = false;
+	p2SString			load_snapshot;
+	p2SString			save_snapshot;
+	// kept between saves, the writer thread reads it until it is joined
+	SnapshotWriter		snapshot;
+	std::thread			snapshot_thread;
+	// seconds between autosaves, 0 when off
+	float				autosave_interval = 0.0f;
+	j1Timer				autosave_time;
+
 	j1PerfTimer			ptimer;
 	uint64				frame_count = 0;
 	j1Timer				startup_time;
@@ -121,7 +174,17 @@ private:
 	uint32				last_sec_frame_count = 0;
 	uint32				prev_last_sec_frame_count = 0;
 	float				dt = 0.0f;
+	float				fixed_step = 0.05f;
+	float				accumulator = 0.0f;
+	float				alpha = 0.0f;
 	int					capped_ms = -1;
+
+	bool				replaying = false;
+	bool				headless = false;
+	p2SString			replay_file;
+	j1PerfTimer			replay_frame_timer;
+	// time each replay frame took, in ms
+	std::vector<double>	replay_frame_ms;
 };
 
 extern j1App* App; // No student is asking me about that ... odd :-S
@@ -3,16 +3,20 @@
 #include "j1Input.h"
 #include "p2Log.h"
 #include "j1Render.h"
+#include "EntityManager.h"
+#include "p2Snapshot.h"
+#include <algorithm>
+#include <climits>
 
 
 j1Collision::j1Collision() : j1Module()
 {
 	name = "collision";
 
-	matrix[SOFT_COLLIDER][SOFT_COLLIDER] = true;
-	matrix[SOFT_COLLIDER][HARD_COLLIDER] = true;
-	matrix[HARD_COLLIDER][SOFT_COLLIDER] = true;
-	matrix[HARD_COLLIDER][HARD_COLLIDER] = true;
+	for (uint i = 0; i < MAX_COLLIDER_LAYERS; ++i)
+		layer_masks[i] = LAYER_NONE;
+
+	SetLayerCollision(LAYER_UNITS, LAYER_UNITS, true);
 
 }
 
@@ -21,56 +25,362 @@ j1Collision::~j1Collision()
 {
 }
 
-bool j1Collision::Awake(pugi::xml_node &)
+bool j1Collision::Awake(pugi::xml_node& config)
 {
+	// enemy units may be let through each other's soft colliders, hard ones still block
+	if (config.attribute("enemy_soft_collision").as_bool(true) == false)
+		SetLayerCollision(LAYER_SOFT_FREE_MEN, LAYER_SOFT_SAURON_ARMY, false);
+
 	return true;
 }
 
 bool j1Collision::Start()
 {
+	colliders.reserve(COLLIDER_POOL_SIZE);
+	slots.reserve(COLLIDER_POOL_SIZE);
+	free_slots.reserve(COLLIDER_POOL_SIZE);
+	worker_contacts.resize(App->workers.GetWorkerCount());
 	return true;
 }
 
 bool j1Collision::PreUpdate()
 {
-	for (p2List_item<Collider*>* it = colliders.start; it; it = it->next) {
-		if (it->data->to_delete == true)
-		{
-			RELEASE(it->data);
-			colliders.del(it);
+#ifndef DETERMINISTIC_SIMULATION
+	DetectCollisions();
+#endif
+
+	return true;
+}
+
+bool j1Collision::FixedUpdate(float step)
+{
+#ifdef DETERMINISTIC_SIMULATION
+	DetectCollisions();
+#endif
+
+	return true;
+}
+
+void j1Collision::DetectCollisions()
+{
+	for (uint i = 0; i < colliders.size(); ++i)
+		colliders[i].colliding = false;
+
+	UpdateBroadphase();
+
+	// narrowphase runs on the workers, callbacks stay on this thread
+	for (uint i = 0; i < worker_contacts.size(); ++i)
+		worker_contacts[i].clear();
+
+	App->workers.ParallelFor(cells.size(), COLLISION_CELLS_PER_JOB, [this](uint begin, uint end, uint worker) {
+		FindContacts(begin, end, worker_contacts[worker]);
+	});
+
+	DispatchContacts();
+}
+
+static int CellCoord(int world)
+{
+	return (world >= 0) ? world / COLLISION_CELL_SIZE : -((-world + COLLISION_CELL_SIZE - 1) / COLLISION_CELL_SIZE);
+}
+
+static uint64 CellKey(int x, int y)
+{
+	return ((uint64)(uint32)y << 32) | (uint64)(uint32)x;
+}
+
+// Cells covered by the collider swept from pos to pred_pos
+void j1Collision::GetCellRange(const Collider* c, int& x1, int& y1, int& x2, int& y2) const
+{
+	x1 = CellCoord(MIN(c->pos.x, c->pred_pos.x) - c->r);
+	y1 = CellCoord(MIN(c->pos.y, c->pred_pos.y) - c->r);
+	x2 = CellCoord(MAX(c->pos.x, c->pred_pos.x) + c->r);
+	y2 = CellCoord(MAX(c->pos.y, c->pred_pos.y) + c->r);
+}
+
+void j1Collision::UpdateBroadphase()
+{
+	entries.clear();
+	cells.clear();
+
+	int x1, y1, x2, y2;
+	grid_x1 = grid_y1 = INT_MAX;
+	grid_x2 = grid_y2 = INT_MIN;
+
+	for (uint i = 0; i < colliders.size(); ++i) {
+		GetCellRange(&colliders[i], x1, y1, x2, y2);
+
+		grid_x1 = MIN(grid_x1, x1); grid_y1 = MIN(grid_y1, y1);
+		grid_x2 = MAX(grid_x2, x2); grid_y2 = MAX(grid_y2, y2);
+
+		for (int y = y1; y <= y2; ++y)
+			for (int x = x1; x <= x2; ++x)
+				entries.push_back({ CellKey(x, y), colliders[i].handle });
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const BroadphaseEntry& a, const BroadphaseEntry& b) {
+		return (a.cell != b.cell) ? a.cell < b.cell : a.collider < b.collider;
+	});
+
+	for (uint i = 0; i < entries.size(); ++i) {
+		if (cells.empty() || cells.back().key != entries[i].cell)
+			cells.push_back({ entries[i].cell, i, 0 });
+
+		cells.back().count++;
+	}
+}
+
+void j1Collision::FindContacts(uint first_cell, uint last_cell, std::vector<ContactPair>& contacts_to_fill) const
+{
+	int ax1, ay1, ax2, ay2;
+	int bx1, by1, bx2, by2;
+
+	for (uint cell = first_cell; cell < last_cell; ++cell) {
+
+		const BroadphaseCell& bc = cells[cell];
+		int cell_x = (int)(uint32)bc.key;
+		int cell_y = (int)(uint32)(bc.key >> 32);
+
+		for (uint i = bc.start; i < bc.start + bc.count; ++i) {
+
+			const Collider* c1 = GetCollider(entries[i].collider);
+			GetCellRange(c1, ax1, ay1, ax2, ay2);
+
+			for (uint j = i + 1; j < bc.start + bc.count; ++j) {
+
+				const Collider* c2 = GetCollider(entries[j].collider);
+
+				if (!(Filter(c1, c2) && c1->callback) && !(Filter(c2, c1) && c2->callback))
+					continue;
+
+				if (c1->entity == c2->entity)
+					continue;
+
+				// pairs sharing several cells are only reported by the first one they share
+				GetCellRange(c2, bx1, by1, bx2, by2);
+				if (MAX(ax1, bx1) != cell_x || MAX(ay1, by1) != cell_y)
+					continue;
+
+				ContactPair contact;
+				contact.c1 = c1->handle;
+				contact.c2 = c2->handle;
+				contact.toi = 0.0f;
+				contact.overlapping = c1->CheckCollision(c2);
+
+				if (contact.c2 < contact.c1)
+					SWAP(contact.c1, contact.c2);
+
+				if (contact.overlapping || ((c1->IsMoving() || c2->IsMoving()) && c1->CheckSweptCollision(c2, contact.toi)))
+					contacts_to_fill.push_back(contact);
+			}
 		}
-		else
-			it->data->colliding = false;
 	}
+}
 
-	Collider *c1;
-	Collider *c2;
+const BroadphaseCell* j1Collision::FindCell(int x, int y) const
+{
+	uint64 key = CellKey(x, y);
+
+	std::vector<BroadphaseCell>::const_iterator it = std::lower_bound(cells.begin(), cells.end(), key,
+		[](const BroadphaseCell& cell, uint64 k) { return cell.key < k; });
+
+	return (it != cells.end() && it->key == key) ? &(*it) : nullptr;
+}
+
+uint j1Collision::QueryPoint(iPoint point, Collider** results, uint max_results, uint32 layers)
+{
+	uint found = 0;
+	const BroadphaseCell* cell = FindCell(CellCoord(point.x), CellCoord(point.y));
+
+	if (cell == nullptr)
+		return 0;
+
+	for (uint i = cell->start; i < cell->start + cell->count && found < max_results; ++i) {
+		Collider* c = GetCollider(entries[i].collider);
 
+		if (c != nullptr && (c->category & layers) != 0 && c->pos.DistanceNoSqrt(point) <= c->r * c->r)
+			results[found++] = c;
+	}
+
+	return found;
+}
 
-	for (p2List_item<Collider*>* col1 = colliders.start; col1; col1 = col1->next) {
-		c1 = col1->data;
+uint j1Collision::QueryCircle(iPoint center, int radius, Collider** results, uint max_results, uint32 layers)
+{
+	uint found = 0;
+	int qx1 = CellCoord(center.x - radius), qy1 = CellCoord(center.y - radius);
+	int qx2 = CellCoord(center.x + radius), qy2 = CellCoord(center.y + radius);
+	int cx1, cy1, cx2, cy2;
 
-		for (p2List_item<Collider*>* col2 = colliders.start; col2; col2 = col2->next) {
-			c2 = col2->data;
+	for (int y = qy1; y <= qy2; ++y) {
+		for (int x = qx1; x <= qx2; ++x) {
 
-			if (c1->CheckCollision(c2) == true) {
+			const BroadphaseCell* cell = FindCell(x, y);
+			if (cell == nullptr)
+				continue;
 
-				if (c1->GetEntity() != c2->GetEntity()) {
+			for (uint i = cell->start; i < cell->start + cell->count; ++i) {
+				Collider* c = GetCollider(entries[i].collider);
 
-					if (matrix[c1->type][c2->type] && c1->callback)
-						c1->callback->OnCollision(c1, c2);
+				if (c == nullptr || (c->category & layers) == 0)
+					continue;
 
+				// colliders spanning several cells are only checked in the first one inside the query
+				GetCellRange(c, cx1, cy1, cx2, cy2);
+				if (MAX(qx1, cx1) != x || MAX(qy1, cy1) != y)
+					continue;
 
-					if (matrix[c2->type][c1->type] && c2->callback)
-						c1->callback->OnCollision(c1, c2);
-						
+				if (c->pos.DistanceNoSqrt(center) <= (c->r + radius) * (c->r + radius)) {
+					results[found++] = c;
+					if (found == max_results)
+						return found;
 				}
 			}
 		}
 	}
-	return true;
+
+	return found;
+}
+
+uint j1Collision::QueryRect(const SDL_Rect& rect, Collider** results, uint max_results, uint32 layers)
+{
+	SDL_Rect r = rect;
+	if (r.w < 0) { r.x += r.w; r.w = -r.w; }
+	if (r.h < 0) { r.y += r.h; r.h = -r.h; }
+
+	uint found = 0;
+	int qx1 = CellCoord(r.x), qy1 = CellCoord(r.y);
+	int qx2 = CellCoord(r.x + r.w), qy2 = CellCoord(r.y + r.h);
+	int cx1, cy1, cx2, cy2;
+
+	for (int y = qy1; y <= qy2; ++y) {
+		for (int x = qx1; x <= qx2; ++x) {
+
+			const BroadphaseCell* cell = FindCell(x, y);
+			if (cell == nullptr)
+				continue;
+
+			for (uint i = cell->start; i < cell->start + cell->count; ++i) {
+				Collider* c = GetCollider(entries[i].collider);
+
+				if (c == nullptr || (c->category & layers) == 0)
+					continue;
+
+				GetCellRange(c, cx1, cy1, cx2, cy2);
+				if (MAX(qx1, cx1) != x || MAX(qy1, cy1) != y)
+					continue;
+
+				if (c->CheckRect(r)) {
+					results[found++] = c;
+					if (found == max_results)
+						return found;
+				}
+			}
+		}
+	}
+
+	return found;
+}
+
+uint j1Collision::Nearest(iPoint point, uint k, Collider** results, uint32 layers)
+{
+	uint found = 0;
+
+	if (k == 0 || cells.empty())
+		return 0;
+
+	int px = CellCoord(point.x), py = CellCoord(point.y);
+	int max_ring = MAX(MAX(px - grid_x1, grid_x2 - px), MAX(py - grid_y1, grid_y2 - py));
+
+	// walk square rings of cells around the point until nothing closer can be found
+	for (int ring = 0; ring <= max_ring; ++ring) {
+
+		if (found == k) {
+			int reach = (ring - 1) * COLLISION_CELL_SIZE;
+			if (results[k - 1]->pos.DistanceNoSqrt(point) <= reach * reach)
+				break;
+		}
+
+		for (int y = py - ring; y <= py + ring; ++y) {
+			int step = (y == py - ring || y == py + ring) ? 1 : ring * 2;
+
+			for (int x = px - ring; x <= px + ring; x += MAX(step, 1)) {
+
+				const BroadphaseCell* cell = FindCell(x, y);
+				if (cell == nullptr)
+					continue;
+
+				for (uint i = cell->start; i < cell->start + cell->count; ++i) {
+					Collider* c = GetCollider(entries[i].collider);
+
+					if (c == nullptr || (c->category & layers) == 0)
+						continue;
+
+					int dist = c->pos.DistanceNoSqrt(point);
+					if (found == k && dist >= results[k - 1]->pos.DistanceNoSqrt(point))
+						continue;
+
+					bool duplicate = false;
+					for (uint j = 0; j < found && !duplicate; ++j)
+						duplicate = (results[j] == c);
+					if (duplicate)
+						continue;
+
+					// insertion keeps the buffer sorted, k is expected to be small
+					uint slot = (found < k) ? found++ : k - 1;
+					while (slot > 0 && results[slot - 1]->pos.DistanceNoSqrt(point) > dist) {
+						results[slot] = results[slot - 1];
+						slot--;
+					}
+					results[slot] = c;
+				}
+			}
+		}
+	}
+
+	return found;
 }
 
+// Merges worker results in a stable order and calls back on the main thread
+void j1Collision::DispatchContacts()
+{
+	contacts.clear();
+
+	for (uint i = 0; i < worker_contacts.size(); ++i)
+		contacts.insert(contacts.end(), worker_contacts[i].begin(), worker_contacts[i].end());
+
+	std::sort(contacts.begin(), contacts.end(), [](const ContactPair& a, const ContactPair& b) {
+		return (a.c1 != b.c1) ? a.c1 < b.c1 : a.c2 < b.c2;
+	});
+
+	Collider *c1;
+	Collider *c2;
+
+	// a callback may delete colliders, which moves others in the pool, so both are looked up again each time
+	for (uint i = 0; i < contacts.size(); ++i) {
+		const ContactPair& contact = contacts[i];
+
+		c1 = GetCollider(contact.c1);
+		c2 = GetCollider(contact.c2);
+
+		if (c1 != nullptr && c2 != nullptr && (contact.overlapping || c1->IsMoving()) && Filter(c1, c2) && c1->callback) {
+			if (contact.overlapping)
+				c1->callback->OnCollision(c1, c2);
+			else
+				c1->callback->OnPredictedCollision(c1, c2, contact.toi);
+		}
+
+		c1 = GetCollider(contact.c1);
+		c2 = GetCollider(contact.c2);
+
+		if (c1 != nullptr && c2 != nullptr && (contact.overlapping || c2->IsMoving()) && Filter(c2, c1) && c2->callback) {
+			if (contact.overlapping)
+				c2->callback->OnCollision(c2, c1);
+			else
+				c2->callback->OnPredictedCollision(c2, c1, contact.toi);
+		}
+	}
+}
 
 bool j1Collision::Update(float dt)
 {
@@ -90,47 +400,273 @@ bool j1Collision::CleanUp()
 {
 	LOG("Freeing colliders");
 
-	for (p2List_item<Collider*>* it = colliders.end; it; it = it->prev)
-		RELEASE(it->data);
-	
-
 	colliders.clear();
+	slots.clear();
+	free_slots.clear();
+
+	return true;
+}
+
+bool j1Collision::LoadSnapshot(SnapshotReader& data)
+{
+	uint count = 0;
+	if (data.Read(count) == false || count > data.Remaining())
+		return false;
+
+	// the pool is only replaced once the whole chunk has been read
+	std::vector<Collider> saved(count);
+	for (uint i = 0; i < count; ++i) {
+		Collider& c = saved[i];
+		bool has_callback = false;
+
+		data.Read(c.handle);
+		data.Read(c.pos);
+		data.Read(c.pred_pos);
+		data.Read(c.r);
+		data.Read(c.colliding);
+		data.Read(c.type);
+		data.Read(c.category);
+		data.Read(c.mask);
+		data.Read(c.entity);
+		data.Read(has_callback);
+
+		c.callback = has_callback ? App->entityManager : nullptr;
+	}
+
+	std::vector<p2HandleSlot> saved_slots;
+	std::vector<uint> saved_free_slots;
+	uint32 saved_masks[MAX_COLLIDER_LAYERS];
+	uint32 saved_enabled = 0;
+
+	if (!data.ReadArray(saved_slots) || !data.ReadArray(saved_free_slots) || !data.Read(saved_masks) || !data.Read(saved_enabled))
+		return false;
+
+	colliders.swap(saved);
+	slots.swap(saved_slots);
+	free_slots.swap(saved_free_slots);
+	memcpy(layer_masks, saved_masks, sizeof(layer_masks));
+	enabled_layers = saved_enabled;
+
+	// the grid still points at the old pool
+	entries.clear();
+	cells.clear();
 
 	return true;
 }
 
-Collider * j1Collision::AddCollider(iPoint position, int radius, COLLIDER_TYPE type, Entity* assigned_entity, j1Module * callback )
+bool j1Collision::SaveSnapshot(SnapshotWriter& data) const
 {
-	Collider* ret = new Collider(position, radius, type, assigned_entity, callback);
-	colliders.add(ret);
+	data.Write((uint)colliders.size());
+
+	for (uint i = 0; i < colliders.size(); ++i) {
+		const Collider& c = colliders[i];
+
+		data.Write(c.handle);
+		data.Write(c.pos);
+		data.Write(c.pred_pos);
+		data.Write(c.r);
+		data.Write(c.colliding);
+		data.Write(c.type);
+		data.Write(c.category);
+		data.Write(c.mask);
+		data.Write(c.entity);
+		// units are the only colliders and report to the entity manager
+		data.Write(c.callback != nullptr);
+	}
+
+	data.WriteArray(slots);
+	data.WriteArray(free_slots);
+	data.Write(layer_masks);
+	data.Write(enabled_layers);
+
+	return true;
+}
+
+ColliderHandle j1Collision::AddCollider(iPoint position, int radius, COLLIDER_TYPE type, uint32 category, Entity* assigned_entity, j1Module * callback )
+{
+	uint slot;
+
+	if (free_slots.empty() == false) {
+		slot = free_slots.back();
+		free_slots.pop_back();
+	}
+	else {
+		slot = slots.size();
+		slots.push_back(p2HandleSlot());
+	}
+
+	slots[slot].dense = colliders.size();
+	colliders.push_back(Collider(position, radius, type, assigned_entity, callback));
+	colliders.back().category = category;
+	colliders.back().mask = GetLayerMask(category);
+
+	ColliderHandle ret;
+	ret.index = slot;
+	ret.generation = slots[slot].generation;
+	colliders.back().handle = ret;
 
 	return ret;
 }
 
-void j1Collision::DeleteCollider(Collider * collider)
+void j1Collision::Reserve(uint count)
 {
-	collider->to_delete = true;
+	count += colliders.size();
+	if (count <= colliders.capacity())
+		return;
+
+	count = MAX(count, (uint)colliders.capacity() * 2);
+	colliders.reserve(count);
+	slots.reserve(count);
+	free_slots.reserve(count);
+}
+
+// Removed right away, its handle goes stale and the broadphase skips it until it is rebuilt
+void j1Collision::DeleteCollider(ColliderHandle collider)
+{
+	if (GetCollider(collider) != nullptr)
+		RemoveCollider(slots[collider.index].dense);
+}
+
+Collider* j1Collision::GetCollider(ColliderHandle collider)
+{
+	if (collider.index >= slots.size() || collider.IsNull() || slots[collider.index].generation != collider.generation)
+		return nullptr;
+
+	return &colliders[slots[collider.index].dense];
+}
+
+const Collider* j1Collision::GetCollider(ColliderHandle collider) const
+{
+	if (collider.index >= slots.size() || collider.IsNull() || slots[collider.index].generation != collider.generation)
+		return nullptr;
+
+	return &colliders[slots[collider.index].dense];
+}
+
+// Makes every layer in layers_a collide (or not) with every layer in layers_b and the other way round
+void j1Collision::SetLayerCollision(uint32 layers_a, uint32 layers_b, bool collide)
+{
+	for (uint i = 0; i < MAX_COLLIDER_LAYERS; ++i) {
+		uint32 layer = 1u << i;
+
+		if (layers_a & layer)
+			layer_masks[i] = collide ? (layer_masks[i] | layers_b) : (layer_masks[i] & ~layers_b);
+
+		if (layers_b & layer)
+			layer_masks[i] = collide ? (layer_masks[i] | layers_a) : (layer_masks[i] & ~layers_a);
+	}
+
+	// live colliders pick up the new masks now so pair tests stay a single AND
+	for (uint i = 0; i < colliders.size(); ++i) {
+		if (colliders[i].category & (layers_a | layers_b))
+			colliders[i].mask = GetLayerMask(colliders[i].category);
+	}
+}
+
+// Switches whole layers on and off without touching their masks
+void j1Collision::EnableLayers(uint32 layers, bool enable)
+{
+	enabled_layers = enable ? (enabled_layers | layers) : (enabled_layers & ~layers);
+}
+
+uint32 j1Collision::GetLayerMask(uint32 category) const
+{
+	uint32 ret = LAYER_NONE;
+
+	for (uint i = 0; i < MAX_COLLIDER_LAYERS; ++i) {
+		if (category & (1u << i))
+			ret |= layer_masks[i];
+	}
+
+	return ret;
+}
+
+// Swaps the last collider into the hole and retires the slot
+void j1Collision::RemoveCollider(uint dense)
+{
+	p2HandleSlot& slot = slots[colliders[dense].handle.index];
+
+	if (++slot.generation == 0)
+		slot.generation = 1;
+
+	free_slots.push_back(colliders[dense].handle.index);
+
+	if (dense != colliders.size() - 1) {
+		colliders[dense] = colliders.back();
+		slots[colliders[dense].handle.index].dense = dense;
+	}
+
+	colliders.pop_back();
 }
 
 // TODO 2  
 
-bool Collider::CheckCollision(Collider* c2) const
+Entity* Collider::GetEntity() const
+{
+	return App->entityManager->GetUnit(entity);
+}
+
+Unit* Collider::GetUnit() const
+{
+	return App->entityManager->GetUnit(entity);
+}
+
+bool Collider::CheckCollision(const Collider* c2) const
 {
 	return (pos.DistanceManhattan(c2->pos) < (r + c2->r));
 }
 
+// Sweeps both circles from pos to pred_pos and returns the earliest contact along the horizon
+bool Collider::CheckSweptCollision(const Collider* c2, float& toi) const
+{
+	float px = (float)(c2->pos.x - pos.x);
+	float py = (float)(c2->pos.y - pos.y);
+
+	// displacement of c2 relative to us over the whole horizon
+	float dx = (float)((c2->pred_pos.x - c2->pos.x) - (pred_pos.x - pos.x));
+	float dy = (float)((c2->pred_pos.y - c2->pos.y) - (pred_pos.y - pos.y));
+
+	float radius = (float)(r + c2->r);
+
+	float a = dx * dx + dy * dy;
+	float b = 2.0f * (px * dx + py * dy);
+	float c = px * px + py * py - radius * radius;
+
+	if (c <= 0.0f) {
+		toi = 0.0f;
+		return true;
+	}
+
+	if (a == 0.0f)
+		return false;
+
+	float disc = b * b - 4.0f * a * c;
+	if (disc < 0.0f)
+		return false;
+
+	toi = (-b - sqrtf(disc)) / (2.0f * a);
+
+	return (toi >= 0.0f && toi <= 1.0f);
+}
+
+bool Collider::CheckRect(const SDL_Rect& rect) const
+{
+	int nearest_x = MAX(rect.x, MIN(pos.x, rect.x + rect.w));
+	int nearest_y = MAX(rect.y, MIN(pos.y, rect.y + rect.h));
+
+	return pos.DistanceNoSqrt(iPoint(nearest_x, nearest_y)) <= r * r;
+}
+
 void j1Collision::DebugDraw()
 {
 
-	for (p2List_item<Collider*>* it = colliders.start; it; it = it->next)
+	for (uint i = 0; i < colliders.size(); ++i)
 	{
-		if (it->data == nullptr) {
-			continue;
-		}
+		const Collider& c = colliders[i];
 
-		if(it->data->colliding)
-			App->render->DrawCircle(it->data->pos.x, it->data->pos.y, it->data->r, 255, 0, 0, 255);
+		if(c.colliding)
+			App->render->DrawCircle(c.pos.x, c.pos.y, c.r, 255, 0, 0, 255);
 		else
-			App->render->DrawCircle(it->data->pos.x, it->data->pos.y, it->data->r, 0, 0, 255, 255);
+			App->render->DrawCircle(c.pos.x, c.pos.y, c.r, 0, 0, 255, 255);
 	}
-}
+}
\ No newline at end of file
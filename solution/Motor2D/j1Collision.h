@@ -7,6 +7,17 @@
 #include "p2Point.h"
 #include "Unit.h"
 #include "p2List.h"
+#include "p2Handle.h"
+#include <vector>
+
+// Broadphase grid cell size in pixels, should be larger than the biggest swept collider
+#define COLLISION_CELL_SIZE 64
+// Minimum amount of cells handed to a worker at once
+#define COLLISION_CELLS_PER_JOB 16
+// Colliders reserved up front by the pool
+#define COLLIDER_POOL_SIZE 1024
+
+typedef p2Handle ColliderHandle;
 
 enum COLLIDER_TYPE
 {
@@ -17,23 +28,47 @@ enum COLLIDER_TYPE
 	COLLIDER_MAX
 };
 
+#define MAX_COLLIDER_LAYERS 32
+
+// A collider belongs to one or more layers (category) and collides with the layers in its mask
+enum COLLIDER_LAYER
+{
+	LAYER_NONE = 0,
+	LAYER_SOFT_FREE_MEN = 1 << 0,
+	LAYER_HARD_FREE_MEN = 1 << 1,
+	LAYER_SOFT_SAURON_ARMY = 1 << 2,
+	LAYER_HARD_SAURON_ARMY = 1 << 3,
+
+	LAYER_SOFT_UNITS = LAYER_SOFT_FREE_MEN | LAYER_SOFT_SAURON_ARMY,
+	LAYER_HARD_UNITS = LAYER_HARD_FREE_MEN | LAYER_HARD_SAURON_ARMY,
+	LAYER_UNITS = LAYER_SOFT_UNITS | LAYER_HARD_UNITS,
+	LAYER_ALL = 0xFFFFFFFF
+};
+
 
 struct Collider
 {
+	ColliderHandle handle;
 	iPoint pos;
+	iPoint pred_pos;
 	int r;
-	bool to_delete = false;
 	bool colliding = false;
 	COLLIDER_TYPE type;
+	uint32 category = LAYER_NONE;
+	uint32 mask = LAYER_NONE;
 	j1Module* callback = nullptr;
-	Entity* entity = NULL;
+	EntityHandle entity;
+
+	Collider() : r(0), type(COLLIDER_NONE)
+	{}
 
 	Collider(iPoint position, int radius, COLLIDER_TYPE type, Entity* assigned_entity, j1Module* callback = nullptr ) :
 		pos(position),
+		pred_pos(position),
 		r(radius),
 		type(type),
 		callback(callback),
-		entity(assigned_entity)
+		entity(assigned_entity->handle)
 	{}
 
 	void SetPos(int x, int y)
@@ -42,17 +77,41 @@ struct Collider
 		pos.y = y;
 	}
 
-	bool CheckCollision(Collider* c2) const;
+	bool CheckCollision(const Collider* c2) const;
+	bool CheckSweptCollision(const Collider* c2, float& toi) const;
+	bool CheckRect(const SDL_Rect& rect) const;
 
-	Entity* GetEntity() 
+	bool IsMoving() const
 	{
-		return entity;
+		return pred_pos != pos;
 	}
 
-	Unit* GetUnit()
-	{
-		return (Unit*)entity;
-	}
+	// nullptr once the owner has been deleted
+	Entity* GetEntity() const;
+	Unit* GetUnit() const;
+};
+
+// Handles rather than dense indices, so colliders deleted after the grid was built are skipped
+struct BroadphaseEntry
+{
+	uint64 cell;
+	ColliderHandle collider;
+};
+
+struct BroadphaseCell
+{
+	uint64 key;
+	uint start;
+	uint count;
+};
+
+// c1 always has the lower handle, callbacks may delete either before the pair is dispatched
+struct ContactPair
+{
+	ColliderHandle c1;
+	ColliderHandle c2;
+	float toi;
+	bool overlapping;
 };
 
 
@@ -73,22 +132,77 @@ public:
 	// Called before all updates
 	bool PreUpdate();
 
+	// Deterministic builds collide once per simulation tick, after the units moved
+	bool FixedUpdate(float step);
+
 	// Called each loop iteration
 	bool Update(float dt);
 
 	// Called before quitting
 	bool CleanUp();
-	Collider* AddCollider(iPoint position, int radius, COLLIDER_TYPE type, Entity* assigned_entity, j1Module * callback);
-	void DeleteCollider(Collider* collider);
+
+	// The whole pool is replaced on load, so handles saved elsewhere stay valid
+	bool LoadSnapshot(SnapshotReader&);
+	bool SaveSnapshot(SnapshotWriter&) const;
+
+	ColliderHandle AddCollider(iPoint position, int radius, COLLIDER_TYPE type, uint32 category, Entity* assigned_entity, j1Module * callback);
+	void DeleteCollider(ColliderHandle collider);
+	// makes room for count more colliders at once
+	void Reserve(uint count);
+	// Returns nullptr if the handle is stale, pointers are only valid until the next AddCollider or DeleteCollider
+	Collider* GetCollider(ColliderHandle collider);
+	const Collider* GetCollider(ColliderHandle collider) const;
 	void DebugDraw();
 
+	// Spatial queries over the broadphase grid, they fill results and return how many were found
+	uint QueryPoint(iPoint point, Collider** results, uint max_results, uint32 layers = LAYER_ALL);
+	uint QueryCircle(iPoint center, int radius, Collider** results, uint max_results, uint32 layers = LAYER_ALL);
+	uint QueryRect(const SDL_Rect& rect, Collider** results, uint max_results, uint32 layers = LAYER_ALL);
+	// The k colliders closest to point, sorted by distance
+	uint Nearest(iPoint point, uint k, Collider** results, uint32 layers = LAYER_ALL);
+
+	// Layers
+	void SetLayerCollision(uint32 layers_a, uint32 layers_b, bool collide);
+	void EnableLayers(uint32 layers, bool enable);
+
+private:
+
+	void DetectCollisions();
+	void UpdateBroadphase();
+	void FindContacts(uint first_cell, uint last_cell, std::vector<ContactPair>& contacts_to_fill) const;
+	void DispatchContacts();
+	void GetCellRange(const Collider* c, int& x1, int& y1, int& x2, int& y2) const;
+	uint32 GetLayerMask(uint32 category) const;
+
 private:
 
-	p2List<Collider*> colliders;
+	const BroadphaseCell* FindCell(int x, int y) const;
+	void RemoveCollider(uint dense);
+
+	// true if c1 wants to hear about c2
+	bool Filter(const Collider* c1, const Collider* c2) const
+	{
+		return (c1->category & enabled_layers) != 0 && (c1->mask & c2->category & enabled_layers) != 0;
+	}
+
+private:
+
+	// pool: colliders are packed in a dense array, handles point to slots that track where they are
+	std::vector<Collider> colliders;
+	std::vector<p2HandleSlot> slots;
+	std::vector<uint> free_slots;
 	bool debug = false;
 
-public:
-	bool matrix[COLLIDER_MAX][COLLIDER_MAX];
+	// rebuilt each frame, memory is kept between frames
+	std::vector<BroadphaseEntry> entries;
+	std::vector<BroadphaseCell> cells;
+	int grid_x1 = 0, grid_y1 = 0, grid_x2 = -1, grid_y2 = -1;
+	std::vector<std::vector<ContactPair>> worker_contacts;
+	std::vector<ContactPair> contacts;
+
+	// collide-with mask of each layer bit
+	uint32 layer_masks[MAX_COLLIDER_LAYERS];
+	uint32 enabled_layers = LAYER_ALL;
 };
 
 #endif // __ModuleCollision_H__
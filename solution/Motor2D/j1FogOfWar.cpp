@@ -0,0 +1,214 @@
+#include "p2Defs.h"
+#include "p2Log.h"
+#include "j1App.h"
+#include "j1Pathfinding.h"
+#include "j1FogOfWar.h"
+#include "p2Snapshot.h"
+
+j1FogOfWar::j1FogOfWar() : j1Module()
+{
+	name.create("fog");
+}
+
+// Destructor
+j1FogOfWar::~j1FogOfWar()
+{}
+
+// Called before render is available
+bool j1FogOfWar::Awake(pugi::xml_node& config)
+{
+	player_faction = config.attribute("player_faction").as_uint(0);
+	occlusion = config.attribute("occlusion").as_bool(false);
+
+	if (player_faction >= MAX_FOG_FACTIONS)
+		player_faction = 0;
+
+	return true;
+}
+
+// Called before quitting
+bool j1FogOfWar::CleanUp()
+{
+	LOG("Freeing fog of war");
+
+	for (uint i = 0; i < MAX_FOG_FACTIONS; i++) {
+		visible[i].clear();
+		explored[i].clear();
+	}
+	stamps.clear();
+
+	return true;
+}
+
+bool j1FogOfWar::LoadSnapshot(SnapshotReader& data)
+{
+	uint saved_width = 0, saved_height = 0;
+	data.Read(saved_width);
+	data.Read(saved_height);
+
+	if (saved_width != width || saved_height != height) {
+		LOG("Snapshot fog is %dx%d, the map is %dx%d", saved_width, saved_height, width, height);
+		return false;
+	}
+
+	// read all of it before touching the grids
+	std::vector<ushort> counts[MAX_FOG_FACTIONS];
+	std::vector<uchar> tiles[MAX_FOG_FACTIONS];
+	for (uint i = 0; i < MAX_FOG_FACTIONS; i++) {
+		if (data.ReadArray(counts[i]) == false || data.ReadArray(tiles[i]) == false || counts[i].size() != width * height || tiles[i].size() != width * height)
+			return false;
+	}
+
+	for (uint i = 0; i < MAX_FOG_FACTIONS; i++) {
+		visible[i].swap(counts[i]);
+
+		for (uint j = 0; j < tiles[i].size(); j++)
+			explored[i][j] = tiles[i][j] != 0;
+	}
+
+	return true;
+}
+
+bool j1FogOfWar::SaveSnapshot(SnapshotWriter& data) const
+{
+	data.Write(width);
+	data.Write(height);
+
+	// explored packs its bits, it goes out one byte per tile
+	std::vector<uchar> tiles(width * height);
+	for (uint i = 0; i < MAX_FOG_FACTIONS; i++) {
+		data.WriteArray(visible[i]);
+
+		for (uint j = 0; j < tiles.size(); j++)
+			tiles[j] = explored[i][j] ? 1 : 0;
+		data.WriteArray(tiles);
+	}
+
+	return true;
+}
+
+void j1FogOfWar::SetMap(uint width, uint height)
+{
+	this->width = width;
+	this->height = height;
+
+	for (uint i = 0; i < MAX_FOG_FACTIONS; i++) {
+		visible[i].assign(width * height, 0);
+		explored[i].assign(width * height, false);
+	}
+}
+
+void j1FogOfWar::AddSight(uint faction, const iPoint& tile, int radius)
+{
+	Stamp(faction, tile, radius, 1);
+}
+
+void j1FogOfWar::RemoveSight(uint faction, const iPoint& tile, int radius)
+{
+	Stamp(faction, tile, radius, -1);
+}
+
+bool j1FogOfWar::IsVisible(uint faction, const iPoint& tile) const
+{
+	return CheckBoundaries(tile) && visible[faction][tile.y * width + tile.x] > 0;
+}
+
+bool j1FogOfWar::IsExplored(uint faction, const iPoint& tile) const
+{
+	return CheckBoundaries(tile) && explored[faction][tile.y * width + tile.x];
+}
+
+bool j1FogOfWar::IsVisible(const iPoint& tile) const
+{
+	return IsVisible(player_faction, tile);
+}
+
+bool j1FogOfWar::IsExplored(const iPoint& tile) const
+{
+	return IsExplored(player_faction, tile);
+}
+
+// Circles are built the first time a radius is used and shared afterwards
+const std::vector<iPoint>& j1FogOfWar::GetStamp(int radius)
+{
+	if (radius >= (int)stamps.size())
+		stamps.resize(radius + 1);
+
+	std::vector<iPoint>& stamp = stamps[radius];
+
+	if (stamp.empty()) {
+		// r * r + r rounds the circle out so radius 1 covers the whole 3x3 block
+		int limit = radius * radius + radius;
+
+		for (int y = -radius; y <= radius; y++) {
+			for (int x = -radius; x <= radius; x++) {
+				if (x * x + y * y <= limit)
+					stamp.push_back(iPoint(x, y));
+			}
+		}
+	}
+
+	return stamp;
+}
+
+void j1FogOfWar::Stamp(uint faction, const iPoint& tile, int radius, int delta)
+{
+	if (faction >= MAX_FOG_FACTIONS || radius < 0)
+		return;
+
+	const std::vector<iPoint>& stamp = GetStamp(radius);
+	std::vector<ushort>& counts = visible[faction];
+
+	for (uint i = 0; i < stamp.size(); i++) {
+		iPoint cell(tile.x + stamp[i].x, tile.y + stamp[i].y);
+
+		if (!CheckBoundaries(cell))
+			continue;
+
+		// the map doesn't change, so removing occludes exactly the same cells adding did
+		if (occlusion && !HasLineOfSight(tile, cell))
+			continue;
+
+		uint index = cell.y * width + cell.x;
+		counts[index] += delta;
+
+		if (delta > 0)
+			explored[faction][index] = true;
+	}
+}
+
+// Bresenham walk from one tile to the other, the tiles in between must be walkable
+bool j1FogOfWar::HasLineOfSight(const iPoint& from, const iPoint& to) const
+{
+	int dx = abs(to.x - from.x), sx = (from.x < to.x) ? 1 : -1;
+	int dy = -abs(to.y - from.y), sy = (from.y < to.y) ? 1 : -1;
+	int err = dx + dy;
+	iPoint current = from;
+
+	if (from == to)
+		return true;
+
+	while (true) {
+		int e2 = 2 * err;
+		if (e2 >= dy) {
+			err += dy;
+			current.x += sx;
+		}
+		if (e2 <= dx) {
+			err += dx;
+			current.y += sy;
+		}
+
+		if (current == to)
+			return true;
+
+		if (!App->pathfinding->IsWalkable(current))
+			return false;
+	}
+}
+
+bool j1FogOfWar::CheckBoundaries(const iPoint& tile) const
+{
+	return (tile.x >= 0 && tile.x < (int)width &&
+		tile.y >= 0 && tile.y < (int)height);
+}
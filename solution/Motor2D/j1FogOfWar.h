@@ -0,0 +1,69 @@
+#ifndef __j1FOGOFWAR_H__
+#define __j1FOGOFWAR_H__
+
+#include "j1Module.h"
+#include "p2Point.h"
+#include <vector>
+
+#define MAX_FOG_FACTIONS 2
+
+// Per faction visibility of the map tiles. Every tile counts how many units see it, units only
+// stamp their sight circle in or out when they change tile so the cost follows movement, not army size.
+class j1FogOfWar : public j1Module
+{
+public:
+
+	j1FogOfWar();
+
+	// Destructor
+	virtual ~j1FogOfWar();
+
+	// Called before render is available
+	bool Awake(pugi::xml_node&);
+
+	// Called before quitting
+	bool CleanUp();
+
+	// Sight counts are saved along with what was explored, they match the units' stamps
+	bool LoadSnapshot(SnapshotReader&);
+	bool SaveSnapshot(SnapshotWriter&) const;
+
+	// Sizes the grids for the map, everything starts hidden
+	void SetMap(uint width, uint height);
+
+	// radius is in tiles, removing must use the same tile and radius the sight was added with
+	void AddSight(uint faction, const iPoint& tile, int radius);
+	void RemoveSight(uint faction, const iPoint& tile, int radius);
+
+	bool IsVisible(uint faction, const iPoint& tile) const;
+	bool IsExplored(uint faction, const iPoint& tile) const;
+
+	// for the local player
+	bool IsVisible(const iPoint& tile) const;
+	bool IsExplored(const iPoint& tile) const;
+
+public:
+
+	uint player_faction = 0;
+
+private:
+
+	const std::vector<iPoint>& GetStamp(int radius);
+	void Stamp(uint faction, const iPoint& tile, int radius, int delta);
+	bool HasLineOfSight(const iPoint& from, const iPoint& to) const;
+	bool CheckBoundaries(const iPoint& tile) const;
+
+private:
+
+	uint width = 0;
+	uint height = 0;
+	// units seeing each tile
+	std::vector<ushort> visible[MAX_FOG_FACTIONS];
+	std::vector<bool> explored[MAX_FOG_FACTIONS];
+	// tile offsets of a sight circle, by radius
+	std::vector<std::vector<iPoint>> stamps;
+	// unwalkable tiles block the sight behind them
+	bool occlusion = false;
+};
+
+#endif // __j1FOGOFWAR_H__
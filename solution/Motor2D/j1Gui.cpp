@@ -71,12 +71,12 @@ bool j1Gui::PreUpdate()
 
 	for (list<UIElement*>::iterator it = Elements.begin(); Priority.size() != Elements.size(); ++it)
 	{
-		switch (it._Ptr->_Myval->priority) {
+		switch ((*it)->priority) {
 		case 0:
-			Priority.push_front(it._Ptr->_Myval);
+			Priority.push_front((*it));
 			break;
 		case 1:
-			Priority.push_back(it._Ptr->_Myval);
+			Priority.push_back((*it));
 			break;
 		}
 	}
@@ -91,8 +91,8 @@ bool j1Gui::PostUpdate()
 	if (App->input->GetKey(SDL_SCANCODE_F1) == KEY_DOWN) {
 		for (list<UIElement*>::iterator it = Elements.begin(); it != Elements.end(); ++it)
 		{
-			if (!it._Ptr->_Myval->debug) it._Ptr->_Myval->debug = true;
-			else it._Ptr->_Myval->debug = false;
+			if (!(*it)->debug) (*it)->debug = true;
+			else (*it)->debug = false;
 		}
 	}
 
@@ -100,8 +100,8 @@ bool j1Gui::PostUpdate()
 	{
 		for (list<UIElement*>::iterator it = Elements.begin(); it != Elements.end(); ++it)
 		{
-			if (it._Ptr->_Myval->enabled == true)
-				it._Ptr->_Myval->Update();
+			if ((*it)->enabled == true)
+				(*it)->Update();
 		}
 	}
 
@@ -119,7 +119,7 @@ bool j1Gui::CleanUp()
 	{
 		for (list<UIElement*>::iterator it = Elements.begin(); it != Elements.end(); ++it)
 		{
-			delete it._Ptr->_Myval;
+			delete (*it);
 		}
 	}
 
@@ -148,8 +148,8 @@ void j1Gui::ScreenMoves(pair<int, int> movement) {
 	{
 		for (list<UIElement*>::iterator it = Elements.begin(); it != Elements.end(); ++it)
 		{
-			if (it._Ptr->_Myval->enabled == true)
-				it._Ptr->_Myval->Movement(movement);
+			if ((*it)->enabled == true)
+				(*it)->Movement(movement);
 		}
 	}
 }
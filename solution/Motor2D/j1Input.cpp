@@ -51,6 +51,18 @@ bool j1Input::PreUpdate()
 	static SDL_Event event;
 
 	mouse_motion_x = mouse_motion_y = 0;
+
+	// replays are driven by their command log, only closing the window gets through
+	if(App->IsReplaying() == true)
+	{
+		while(SDL_PollEvent(&event) != 0)
+		{
+			if(event.type == SDL_QUIT)
+				windowEvents[WE_QUIT] = true;
+		}
+
+		return true;
+	}
 	
 	const Uint8* keys = SDL_GetKeyboardState(NULL);
 
@@ -5,6 +5,7 @@
 #include "j1FileSystem.h"
 #include "j1Textures.h"
 #include "j1Map.h"
+#include "j1FogOfWar.h"
 #include <math.h>
 
 j1Map::j1Map() : j1Module(), map_loaded(false)
@@ -46,7 +47,9 @@ void j1Map::Draw()
 			for(int x = 0; x < data.width; ++x)
 			{
 				int tile_id = layer->Get(x, y);
-				if(tile_id > 0)
+
+				// never seen tiles stay black
+				if(tile_id > 0 && App->fog->IsExplored(iPoint(x, y)))
 				{
 					TileSet* tileset = GetTilesetFromTileId(tile_id);
 
@@ -22,6 +22,8 @@ struct Command;
 enum GuiEvents;
 struct CVar;
 struct Collider;
+class SnapshotReader;
+class SnapshotWriter;
 
 class j1Module
 {
@@ -62,6 +64,12 @@ public:
 		return true;
 	}
 
+	// Called zero or more times per loop iteration, always with the same step
+	virtual bool FixedUpdate(float step)
+	{
+		return true;
+	}
+
 	// Called each loop iteration
 	virtual bool PostUpdate()
 	{
@@ -84,6 +92,17 @@ public:
 		return true;
 	}
 
+	// Binary state for quick saves, read back in the order it was written
+	virtual bool LoadSnapshot(SnapshotReader&)
+	{
+		return true;
+	}
+
+	virtual bool SaveSnapshot(SnapshotWriter&) const
+	{
+		return true;
+	}
+
 	virtual void OnGui(Gui* ui, GuiEvents event)
 	{}
 
@@ -98,6 +117,10 @@ public:
 	virtual void OnCollision(Collider* c1, Collider* c2)
 	{}
 
+	// toi is the fraction [0..1] of the prediction horizon at which c1 and c2 will meet
+	virtual void OnPredictedCollision(Collider* c1, Collider* c2, float toi)
+	{}
+
 public:
 
 	p2SString	name;
@@ -3,6 +3,7 @@
 #include "j1App.h"
 #include "j1Window.h"
 #include "j1Render.h"
+#include "p2Snapshot.h"
 
 #define VSYNC true
 
@@ -27,7 +28,10 @@ bool j1Render::Awake(pugi::xml_node& config)
 	// load flags
 	Uint32 flags = SDL_RENDERER_ACCELERATED;
 
-	if(config.child("vsync").attribute("value").as_bool(true) == true)
+	headless = App->IsHeadless();
+
+	// replays run as fast as they can
+	if(config.child("vsync").attribute("value").as_bool(true) == true && App->IsReplaying() == false)
 	{
 		flags |= SDL_RENDERER_PRESENTVSYNC;
 		LOG("Using vsync");
@@ -63,14 +67,16 @@ bool j1Render::Start()
 // Called each loop iteration
 bool j1Render::PreUpdate()
 {
-	SDL_RenderClear(renderer);
+	if(headless == false)
+		SDL_RenderClear(renderer);
 	return true;
 }
 
 bool j1Render::PostUpdate()
 {
 	SDL_SetRenderDrawColor(renderer, background.r, background.g, background.g, background.a);
-	SDL_RenderPresent(renderer);
+	if(headless == false)
+		SDL_RenderPresent(renderer);
 	return true;
 }
 
@@ -102,6 +108,25 @@ bool j1Render::Save(pugi::xml_node& data) const
 	return true;
 }
 
+bool j1Render::LoadSnapshot(SnapshotReader& data)
+{
+	int x = 0, y = 0;
+	if (!data.Read(x) || !data.Read(y))
+		return false;
+
+	camera.x = x;
+	camera.y = y;
+	return true;
+}
+
+bool j1Render::SaveSnapshot(SnapshotWriter& data) const
+{
+	data.Write(camera.x);
+	data.Write(camera.y);
+
+	return true;
+}
+
 void j1Render::SetBackgroundColor(SDL_Color color)
 {
 	background = color;
@@ -133,6 +158,10 @@ iPoint j1Render::ScreenToWorld(int x, int y) const
 bool j1Render::Blit(const SDL_Texture* texture, int x, int y, const SDL_Rect* section, float speed, double angle, int pivot_x, int pivot_y) const
 {
 	bool ret = true;
+
+	if(headless == true)
+		return ret;
+
 	uint scale = App->win->GetScale();
 
 	SDL_Rect rect;
@@ -174,6 +203,10 @@ bool j1Render::Blit(const SDL_Texture* texture, int x, int y, const SDL_Rect* se
 bool j1Render::DrawQuad(const SDL_Rect& rect, Uint8 r, Uint8 g, Uint8 b, Uint8 a, bool filled, bool use_camera) const
 {
 	bool ret = true;
+
+	if(headless == true)
+		return ret;
+
 	uint scale = App->win->GetScale();
 
 	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
@@ -202,6 +235,10 @@ bool j1Render::DrawQuad(const SDL_Rect& rect, Uint8 r, Uint8 g, Uint8 b, Uint8 a
 bool j1Render::DrawLine(int x1, int y1, int x2, int y2, Uint8 r, Uint8 g, Uint8 b, Uint8 a, bool use_camera) const
 {
 	bool ret = true;
+
+	if(headless == true)
+		return ret;
+
 	uint scale = App->win->GetScale();
 
 	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
@@ -226,6 +263,10 @@ bool j1Render::DrawLine(int x1, int y1, int x2, int y2, Uint8 r, Uint8 g, Uint8
 bool j1Render::DrawCircle(int x, int y, int radius, Uint8 r, Uint8 g, Uint8 b, Uint8 a, bool use_camera) const
 {
 	bool ret = true;
+
+	if(headless == true)
+		return ret;
+
 	uint scale = App->win->GetScale();
 
 	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
@@ -31,6 +31,8 @@ public:
 	// Load / Save
 	bool Load(pugi::xml_node&);
 	bool Save(pugi::xml_node&) const;
+	bool LoadSnapshot(SnapshotReader&);
+	bool SaveSnapshot(SnapshotWriter&) const;
 
 
 	// Utils
@@ -53,6 +55,8 @@ public:
 	SDL_Rect		camera;
 	SDL_Rect		viewport;
 	SDL_Color		background;
+	// nothing is drawn while running headless
+	bool			headless = false;
 };
 
 #endif // __j1RENDER_H__
\ No newline at end of file
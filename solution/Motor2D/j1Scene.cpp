@@ -5,6 +5,7 @@
 #include "j1Window.h"
 #include "j1Map.h"
 #include "j1PathFinding.h"
+#include "j1FogOfWar.h"
 #include "j1Scene.h"
 #include "p2Log.h"
 #include "EntityManager.h"
@@ -39,20 +40,18 @@ bool j1Scene::Start()
 		if (App->map->CreateWalkabilityMap(w, h, &data))
 			App->pathfinding->SetMap(w, h, data);
 
+		App->fog->SetMap(App->map->data.width, App->map->data.height);
+
 		RELEASE_ARRAY(data);
 	}
 
 	debug_tex = App->tex->Load("maps/path2.png");
 
 	//Test
-	elvenArcher = App->entityManager->CreateUnit(320, 450, false, ELVEN_ARCHER);
-	elvenArcher = App->entityManager->CreateUnit(380, 450, false, ELVEN_ARCHER);
-
-	elvenArcher = App->entityManager->CreateUnit(320, 350, false, ELVEN_ARCHER);
-	elvenArcher = App->entityManager->CreateUnit(380, 350, false, ELVEN_ARCHER);
-
-	elvenArcher = App->entityManager->CreateUnit(320, 250, false, ELVEN_ARCHER);
-	elvenArcher = App->entityManager->CreateUnit(380, 250, false, ELVEN_ARCHER);
+	iPoint archers[] = { iPoint(320, 450), iPoint(380, 450), iPoint(320, 350), iPoint(380, 350), iPoint(320, 250), iPoint(380, 250) };
+	Unit* spawned[6] = { nullptr };
+	App->entityManager->CreateUnits(ELVEN_ARCHER, archers, 6, false, spawned);
+	elvenArcher = spawned[5];
 
 	return true;
 }
@@ -70,6 +69,12 @@ bool j1Scene::Update(float dt)
 		debug = !debug;
 	}
 
+	if (App->input->GetKey(SDL_SCANCODE_F5) == KEY_DOWN)
+		App->SaveSnapshot("quicksave.snap");
+
+	if (App->input->GetKey(SDL_SCANCODE_F6) == KEY_DOWN)
+		App->LoadSnapshot("quicksave.snap");
+
 	if (App->input->GetKey(SDL_SCANCODE_UP) == KEY_REPEAT)
 		App->render->camera.y += 200 * dt;
 
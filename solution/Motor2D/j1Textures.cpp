@@ -47,6 +47,7 @@ bool j1Textures::Start()
 bool j1Textures::CleanUp()
 {
 	LOG("Freeing textures and Image library");
+	LOG("Texture cache: %u hits, %u misses", cache_hits, cache_misses);
 	p2List_item<SDL_Texture*>* item;
 
 	for(item = textures.start; item != NULL; item = item->next)
@@ -55,6 +56,8 @@ bool j1Textures::CleanUp()
 	}
 
 	textures.clear();
+	cache.clear();
+	cache_paths.clear();
 	IMG_Quit();
 	return true;
 }
@@ -62,6 +65,17 @@ bool j1Textures::CleanUp()
 // Load new texture from file path
 SDL_Texture* const j1Textures::Load(const char* path)
 {
+	std::map<std::string, CachedTexture>::iterator cached = cache.find(path);
+
+	if(cached != cache.end())
+	{
+		cache_hits++;
+		cached->second.refs++;
+		return cached->second.texture;
+	}
+
+	cache_misses++;
+
 	SDL_Texture* texture = NULL;
 	SDL_Surface* surface = IMG_Load_RW(App->fs->Load(path), 1);
 
@@ -75,12 +89,33 @@ SDL_Texture* const j1Textures::Load(const char* path)
 		SDL_FreeSurface(surface);
 	}
 
+	if(texture != NULL)
+	{
+		CachedTexture& entry = cache[path];
+		entry.texture = texture;
+		entry.refs = 1;
+		cache_paths[texture] = path;
+	}
+
 	return texture;
 }
 
 // Unload texture
 bool j1Textures::UnLoad(SDL_Texture* texture)
 {
+	std::map<const SDL_Texture*, std::string>::iterator cached = cache_paths.find(texture);
+
+	if(cached != cache_paths.end())
+	{
+		CachedTexture& entry = cache[cached->second];
+
+		if(--entry.refs > 0)
+			return true;
+
+		cache.erase(cached->second);
+		cache_paths.erase(cached);
+	}
+
 	p2List_item<SDL_Texture*>* item;
 
 	for(item = textures.start; item != NULL; item = item->next)
@@ -118,3 +153,14 @@ void j1Textures::GetSize(const SDL_Texture* texture, uint& width, uint& height)
 {
 	SDL_QueryTexture((SDL_Texture*)texture, NULL, NULL, (int*) &width, (int*) &height);
 }
+
+// Cache statistics
+uint j1Textures::GetCacheHits() const
+{
+	return cache_hits;
+}
+
+uint j1Textures::GetCacheMisses() const
+{
+	return cache_misses;
+}
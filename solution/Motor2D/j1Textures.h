@@ -3,10 +3,18 @@
 
 #include "j1Module.h"
 #include "p2List.h"
+#include <map>
+#include <string>
 
 struct SDL_Texture;
 struct SDL_Surface;
 
+struct CachedTexture
+{
+	SDL_Texture* texture = nullptr;
+	uint refs = 0;
+};
+
 class j1Textures : public j1Module
 {
 public:
@@ -31,9 +39,20 @@ public:
 	SDL_Texture* const	LoadSurface(SDL_Surface* surface);
 	void				GetSize(const SDL_Texture* texture, uint& width, uint& height) const;
 
+	uint				GetCacheHits() const;
+	uint				GetCacheMisses() const;
+
 public:
 
 	p2List<SDL_Texture*>	textures;
+
+private:
+
+	// textures loaded from a file are shared by path and freed when the last user unloads them
+	std::map<std::string, CachedTexture>		cache;
+	std::map<const SDL_Texture*, std::string>	cache_paths;
+	uint									cache_hits = 0;
+	uint									cache_misses = 0;
 };
 
 
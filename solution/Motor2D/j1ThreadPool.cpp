@@ -0,0 +1,132 @@
+// ----------------------------------------------------
+// j1ThreadPool.cpp
+// Fork-join worker threads for data parallel loops
+// ----------------------------------------------------
+
+#include "j1ThreadPool.h"
+#include "p2Log.h"
+
+// ---------------------------------------------
+j1ThreadPool::j1ThreadPool() : next_chunk(0), busy_workers(0)
+{}
+
+// ---------------------------------------------
+j1ThreadPool::~j1ThreadPool()
+{
+	CleanUp();
+}
+
+// ---------------------------------------------
+void j1ThreadPool::Init(uint num_threads)
+{
+	CleanUp();
+
+	if (num_threads == 0)
+	{
+		uint cores = std::thread::hardware_concurrency();
+		num_threads = (cores > 1) ? cores - 1 : 0;
+	}
+
+	quit = false;
+	for (uint i = 0; i < num_threads; ++i)
+		threads.push_back(std::thread(&j1ThreadPool::WorkerLoop, this, i + 1));
+
+	LOG("Thread pool running %u workers", num_threads + 1);
+}
+
+// ---------------------------------------------
+void j1ThreadPool::CleanUp()
+{
+	if (threads.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (uint i = 0; i < threads.size(); ++i)
+		threads[i].join();
+
+	threads.clear();
+}
+
+// ---------------------------------------------
+uint j1ThreadPool::GetWorkerCount() const
+{
+	return threads.size() + 1;
+}
+
+// ---------------------------------------------
+void j1ThreadPool::ParallelFor(uint count, uint min_chunk, const ParallelJob& job)
+{
+	if (count == 0)
+		return;
+
+	if (min_chunk == 0)
+		min_chunk = 1;
+
+	// not worth waking anybody up
+	if (threads.empty() || count <= min_chunk)
+	{
+		job(0, count, 0);
+		return;
+	}
+
+	// a few chunks per worker so faster ones can steal the remainder
+	uint chunk = count / (GetWorkerCount() * 4);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->job = &job;
+		this->count = count;
+		this->chunk = MAX(chunk, min_chunk);
+		next_chunk = 0;
+		busy_workers = threads.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	RunChunks(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return busy_workers == 0; });
+	this->job = nullptr;
+}
+
+// ---------------------------------------------
+void j1ThreadPool::WorkerLoop(uint worker)
+{
+	uint seen_generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return quit || generation != seen_generation; });
+
+			if (quit)
+				return;
+
+			seen_generation = generation;
+		}
+
+		RunChunks(worker);
+
+		if (--busy_workers == 0)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done.notify_one();
+		}
+	}
+}
+
+// ---------------------------------------------
+void j1ThreadPool::RunChunks(uint worker)
+{
+	uint begin;
+
+	while ((begin = (next_chunk++) * chunk) < count)
+		(*job)(begin, MIN(begin + chunk, count), worker);
+}
@@ -0,0 +1,56 @@
+#ifndef __j1THREADPOOL_H__
+#define __j1THREADPOOL_H__
+
+#include "p2Defs.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+// job(begin, end, worker) processes items [begin, end) on worker [0..GetWorkerCount())
+typedef std::function<void(uint, uint, uint)> ParallelJob;
+
+class j1ThreadPool
+{
+public:
+
+	// Constructor
+	j1ThreadPool();
+
+	// Destructor
+	~j1ThreadPool();
+
+	// Spawns the worker threads, 0 means one per core besides the main thread
+	void Init(uint num_threads = 0);
+	void CleanUp();
+
+	// Workers available to a job, the calling thread counts as worker 0
+	uint GetWorkerCount() const;
+
+	// Splits [0, count) in chunks of at least min_chunk items and blocks until all of them are done
+	void ParallelFor(uint count, uint min_chunk, const ParallelJob& job);
+
+private:
+
+	void WorkerLoop(uint worker);
+	void RunChunks(uint worker);
+
+private:
+
+	std::vector<std::thread>	threads;
+	std::mutex					mutex;
+	std::condition_variable		wake;
+	std::condition_variable		done;
+
+	const ParallelJob*			job = nullptr;
+	uint						count = 0;
+	uint						chunk = 0;
+	std::atomic<uint>			next_chunk;
+	std::atomic<uint>			busy_workers;
+	uint						generation = 0;
+	bool						quit = false;
+};
+
+#endif //__j1THREADPOOL_H__
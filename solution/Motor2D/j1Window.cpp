@@ -32,7 +32,7 @@ bool j1Window::Awake(pugi::xml_node& config)
 	else
 	{
 		//Create window
-		Uint32 flags = SDL_WINDOW_SHOWN;
+		Uint32 flags = (App->IsHeadless() == true) ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN;
 		bool fullscreen = config.child("fullscreen").attribute("value").as_bool(false);
 		bool borderless = config.child("borderless").attribute("value").as_bool(false);
 		bool resizable = config.child("resizable").attribute("value").as_bool(false);
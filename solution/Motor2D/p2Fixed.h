@@ -0,0 +1,255 @@
+// ----------------------------------------------------
+// Fixed point number    -----------
+// ----------------------------------------------------
+
+#ifndef __P2FIXED_H__
+#define __P2FIXED_H__
+
+#include "p2Defs.h"
+#include "p2Point.h"
+#include <math.h>
+#include <float.h>
+
+#define FIXED_FRACTION_BITS 16
+#define FIXED_ONE ((__int64)1 << FIXED_FRACTION_BITS)
+
+// Integer square root, rounded down. Only shifts, adds and compares so every machine gets the same bits
+inline uint64 ISqrt(uint64 n)
+{
+	uint64 result = 0;
+	uint64 bit = (uint64)1 << 62;
+
+	while (bit > n)
+		bit >>= 2;
+
+	while (bit != 0) {
+		if (n >= result + bit) {
+			n -= result + bit;
+			result = (result >> 1) + bit;
+		}
+		else
+			result >>= 1;
+		bit >>= 2;
+	}
+
+	return result;
+}
+
+// 48.16 fixed point. Integer operations give the same result on every compiler and optimization
+// level, unlike floats. Products are computed with 128 bits and rounded towards zero, divisions
+// need the dividend under 2^31.
+class p2Fixed
+{
+public:
+
+	__int64 raw;
+
+	p2Fixed() : raw(0)
+	{}
+
+	p2Fixed(int value) : raw((__int64)value * FIXED_ONE)
+	{}
+
+	// floats only come in from data files and constants, never from simulated values
+	explicit p2Fixed(float value) : raw((__int64)floor((double)value * FIXED_ONE + 0.5))
+	{}
+
+	explicit p2Fixed(double value) : raw((__int64)floor(value * FIXED_ONE + 0.5))
+	{}
+
+	static p2Fixed FromRaw(__int64 raw)
+	{
+		p2Fixed f;
+		f.raw = raw;
+		return f;
+	}
+
+	static p2Fixed Max()
+	{
+		return FromRaw(0x7FFFFFFFFFFFFFFFLL);
+	}
+
+	float ToFloat() const
+	{
+		return (float)((double)raw / FIXED_ONE);
+	}
+
+	// rounded down
+	int ToInt() const
+	{
+		return (int)(raw >> FIXED_FRACTION_BITS);
+	}
+
+	// Math ------------------------------------------------
+	friend p2Fixed operator +(const p2Fixed& a, const p2Fixed& b)
+	{
+		return FromRaw(a.raw + b.raw);
+	}
+
+	friend p2Fixed operator -(const p2Fixed& a, const p2Fixed& b)
+	{
+		return FromRaw(a.raw - b.raw);
+	}
+
+	friend p2Fixed operator *(const p2Fixed& a, const p2Fixed& b)
+	{
+		return FromRaw(Multiply(a.raw, b.raw));
+	}
+
+	friend p2Fixed operator /(const p2Fixed& a, const p2Fixed& b)
+	{
+		return FromRaw((a.raw * FIXED_ONE) / b.raw);
+	}
+
+	p2Fixed operator -() const
+	{
+		return FromRaw(-raw);
+	}
+
+	const p2Fixed& operator +=(const p2Fixed& f)
+	{
+		raw += f.raw;
+		return(*this);
+	}
+
+	const p2Fixed& operator -=(const p2Fixed& f)
+	{
+		raw -= f.raw;
+		return(*this);
+	}
+
+	const p2Fixed& operator *=(const p2Fixed& f)
+	{
+		raw = Multiply(raw, f.raw);
+		return(*this);
+	}
+
+	const p2Fixed& operator /=(const p2Fixed& f)
+	{
+		raw = (raw * FIXED_ONE) / f.raw;
+		return(*this);
+	}
+
+	friend bool operator ==(const p2Fixed& a, const p2Fixed& b) { return a.raw == b.raw; }
+	friend bool operator !=(const p2Fixed& a, const p2Fixed& b) { return a.raw != b.raw; }
+	friend bool operator <(const p2Fixed& a, const p2Fixed& b) { return a.raw < b.raw; }
+	friend bool operator >(const p2Fixed& a, const p2Fixed& b) { return a.raw > b.raw; }
+	friend bool operator <=(const p2Fixed& a, const p2Fixed& b) { return a.raw <= b.raw; }
+	friend bool operator >=(const p2Fixed& a, const p2Fixed& b) { return a.raw >= b.raw; }
+
+private:
+
+	static __int64 Multiply(__int64 a, __int64 b)
+	{
+		bool negative = (a < 0) != (b < 0);
+		uint64 ua = (a < 0) ? (uint64)-a : (uint64)a;
+		uint64 ub = (b < 0) ? (uint64)-b : (uint64)b;
+		uint64 result;
+
+		if ((ua >> 31) == 0 && (ub >> 31) == 0) {
+			result = (ua * ub) >> FIXED_FRACTION_BITS;
+		}
+		else {
+			// 64x64 bits in 32 bit halves
+			uint64 a_hi = ua >> 32, a_lo = ua & 0xFFFFFFFF;
+			uint64 b_hi = ub >> 32, b_lo = ub & 0xFFFFFFFF;
+			uint64 cross = a_hi * b_lo;
+			uint64 cross2 = a_lo * b_hi;
+			uint64 cross_carry = 0;
+
+			cross += cross2;
+			if (cross < cross2)
+				cross_carry = (uint64)1 << 32;
+
+			uint64 lo = a_lo * b_lo;
+			uint64 lo_sum = lo + (cross << 32);
+			uint64 hi = a_hi * b_hi + (cross >> 32) + cross_carry + ((lo_sum < lo) ? 1 : 0);
+
+			result = (hi << (64 - FIXED_FRACTION_BITS)) | (lo_sum >> FIXED_FRACTION_BITS);
+		}
+
+		return negative ? -(__int64)result : (__int64)result;
+	}
+};
+
+inline p2Fixed Sqrt(const p2Fixed& f)
+{
+	if (f.raw <= 0)
+		return p2Fixed();
+
+	// shifting up keeps the fraction bits, huge values give some of them up instead of overflowing
+	if (f.raw < ((__int64)1 << (62 - FIXED_FRACTION_BITS)))
+		return p2Fixed::FromRaw((__int64)ISqrt((uint64)f.raw << FIXED_FRACTION_BITS));
+
+	return p2Fixed::FromRaw((__int64)ISqrt((uint64)f.raw) << (FIXED_FRACTION_BITS / 2));
+}
+
+inline p2Fixed Abs(const p2Fixed& f)
+{
+	return (f.raw < 0) ? -f : f;
+}
+
+inline float ToFloat(const p2Fixed& f)
+{
+	return f.ToFloat();
+}
+
+inline int RoundToInt(const p2Fixed& f)
+{
+	return (int)((f.raw + FIXED_ONE / 2) >> FIXED_FRACTION_BITS);
+}
+
+// the same helpers for float, so simulation code builds with either
+inline float Sqrt(float f)
+{
+	return sqrtf(f);
+}
+
+inline float Abs(float f)
+{
+	return fabsf(f);
+}
+
+inline float ToFloat(float f)
+{
+	return f;
+}
+
+inline int RoundToInt(float f)
+{
+	return int(floorf(f + 0.5f));
+}
+
+// Distances ---------------------------------------------
+template<>
+inline p2Fixed p2Point<p2Fixed>::DistanceTo(const p2Point<p2Fixed>& v) const
+{
+	return Sqrt(DistanceNoSqrt(v));
+}
+
+template<>
+inline void p2Point<p2Fixed>::Normalize()
+{
+	p2Fixed module = Sqrt(x * x + y * y);
+	if (module == 0)
+		return;
+
+	x = x / module;
+	y = y / module;
+}
+
+typedef p2Point<p2Fixed> xPoint;
+
+// Simulation scalar. Define DETERMINISTIC_SIMULATION in the project to simulate in fixed point,
+// then the same commands give bit identical units on every machine, as lockstep and replays need.
+#ifdef DETERMINISTIC_SIMULATION
+typedef p2Fixed simScalar;
+#define SIM_SCALAR_MAX p2Fixed::Max()
+#else
+typedef float simScalar;
+#define SIM_SCALAR_MAX FLT_MAX
+#endif
+
+typedef p2Point<simScalar> simPoint;
+
+#endif // __P2FIXED_H__
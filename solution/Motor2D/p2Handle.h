@@ -0,0 +1,45 @@
+// ----------------------------------------------------
+// Generational handle to a pooled object    ----------
+// ----------------------------------------------------
+
+#ifndef __P2HANDLE_H__
+#define __P2HANDLE_H__
+
+#include "p2Defs.h"
+
+// index points to a slot in the owner's pool, generation changes every time the slot
+// is recycled so handles to released objects can be told apart. Generation 0 is never used.
+struct p2Handle
+{
+	uint index = 0;
+	uint generation = 0;
+
+	bool IsNull() const
+	{
+		return generation == 0;
+	}
+
+	bool operator ==(const p2Handle& h) const
+	{
+		return (index == h.index && generation == h.generation);
+	}
+
+	bool operator !=(const p2Handle& h) const
+	{
+		return (index != h.index || generation != h.generation);
+	}
+
+	bool operator <(const p2Handle& h) const
+	{
+		return (index != h.index) ? index < h.index : generation < h.generation;
+	}
+};
+
+// Slot of a pool: where the object lives in the dense array and its current generation
+struct p2HandleSlot
+{
+	uint dense = 0;
+	uint generation = 1;
+};
+
+#endif // __P2HANDLE_H__
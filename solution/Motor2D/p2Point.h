@@ -59,7 +59,8 @@ public:
 		return(r);
 	}
 
-	p2Point operator * (const float& m) const
+	template<class SCALAR>
+	p2Point operator * (const SCALAR& m) const
 	{
 		p2Point r;
 
@@ -0,0 +1,142 @@
+// ----------------------------------------------------
+// Binary snapshot streams    -----------
+// ----------------------------------------------------
+
+#ifndef __P2SNAPSHOT_H__
+#define __P2SNAPSHOT_H__
+
+#include "p2Defs.h"
+#include <vector>
+#include <string.h>
+
+// Values are copied as they are laid out in memory, so a snapshot is only meant to be read
+// back by the same build. Everything goes to one buffer, which keeps its memory between saves.
+class SnapshotWriter
+{
+public:
+
+	void Clear()
+	{
+		buffer.clear();
+	}
+
+	const char* Data() const
+	{
+		return buffer.empty() ? NULL : &buffer[0];
+	}
+
+	uint Size() const
+	{
+		return buffer.size();
+	}
+
+	void WriteBytes(const void* data, uint size)
+	{
+		if (size == 0)
+			return;
+
+		uint at = buffer.size();
+		buffer.resize(at + size);
+		memcpy(&buffer[at], data, size);
+	}
+
+	template<class TYPE>
+	void Write(const TYPE& value)
+	{
+		WriteBytes(&value, sizeof(TYPE));
+	}
+
+	// count first, then the elements in one go
+	template<class TYPE>
+	void WriteArray(const std::vector<TYPE>& values)
+	{
+		Write((uint)values.size());
+		if (values.empty() == false)
+			WriteBytes(&values[0], values.size() * sizeof(TYPE));
+	}
+
+	// overwrites a value written before, for sizes only known once their data is written
+	template<class TYPE>
+	void Patch(uint offset, const TYPE& value)
+	{
+		memcpy(&buffer[offset], &value, sizeof(TYPE));
+	}
+
+private:
+
+	std::vector<char> buffer;
+};
+
+// Reads a snapshot in the order it was written. Reading past the end fails and keeps failing,
+// so a whole block can be read and checked once at the end.
+class SnapshotReader
+{
+public:
+
+	SnapshotReader(const char* data, uint size) : data(data), size(size)
+	{}
+
+	bool Failed() const
+	{
+		return failed;
+	}
+
+	uint Remaining() const
+	{
+		return size - position;
+	}
+
+	bool ReadBytes(void* destination, uint count)
+	{
+		if (failed || count > Remaining()) {
+			failed = true;
+			return false;
+		}
+
+		if (count > 0)
+			memcpy(destination, data + position, count);
+		position += count;
+		return true;
+	}
+
+	template<class TYPE>
+	bool Read(TYPE& value)
+	{
+		return ReadBytes(&value, sizeof(TYPE));
+	}
+
+	template<class TYPE>
+	bool ReadArray(std::vector<TYPE>& values)
+	{
+		uint count = 0;
+		if (Read(count) == false || count > Remaining() / sizeof(TYPE)) {
+			failed = true;
+			return false;
+		}
+
+		values.resize(count);
+		return (count == 0) || ReadBytes(&values[0], count * sizeof(TYPE));
+	}
+
+	// a reader over the next count bytes, which are skipped here
+	SnapshotReader Split(uint count)
+	{
+		if (failed || count > Remaining()) {
+			failed = true;
+			return SnapshotReader(data, 0);
+		}
+
+		SnapshotReader ret(data + position, count);
+		position += count;
+		return ret;
+	}
+
+private:
+
+	const char* data;
+	uint size;
+	uint position = 0;
+	bool failed = false;
+};
+
+#endif // __P2SNAPSHOT_H__